@@ -9,18 +9,75 @@
 #import <Foundation/Foundation.h>
 #import "FieldResource.h"
 
+/**
+ * A local BigML anomaly detector.
+ *
+ * The isolation forest is compiled at load into flat, breadth-first node and
+ * split tables, in the ModelArchive layout, and scoring only reads them, so
+ * a single Anomaly can score inputs from several threads at once.
+ */
 @interface Anomaly : FieldResource
 
-@property (nonatomic) BOOL stopped;
 @property (nonatomic) double sampleSize;
 @property (nonatomic) double meanDepth;
 @property (nonatomic) double expectedMeanDepth;
 @property (nonatomic) NSUInteger anomalyCount;
 @property (nonatomic, strong) NSString* inputFields;
-@property (nonatomic, strong) NSArray* iForest;
+@property (nonatomic, readonly) NSUInteger treeCount;
+@property (nonatomic, readonly) NSUInteger nodeCount;
 @property (nonatomic, strong) NSArray* topAnomalies;
 
 - (instancetype)initWithJSONAnomaly:(NSDictionary*)anomalyDictionary;
+
+/**
+ * Maps an anomaly detector written by writeToFile:error:. Scoring walks
+ * the mapped tables, so loading builds no tree.
+ * @return nil, setting error, if the file cannot be read or is not a valid
+ *         isolation forest archive
+ */
+- (instancetype)initWithContentsOfFile:(NSString*)path error:(NSError**)error;
+
+/**
+ * Writes the compiled isolation forest to a binary ModelArchive. Only the
+ * fields' names, types and text analysis are kept.
+ * @return YES if the archive was written
+ */
+- (BOOL)writeToFile:(NSString*)path error:(NSError**)error;
+
 - (double)score:(NSDictionary*)input options:(NSDictionary*)options;
 
+/**
+ * Scores many inputs at once, spreading the rows across cores.
+ * @param inputs The rows to score, as accepted by score:options:
+ * @param options The options accepted by score:options:, plus:
+ *        - threads: Maximum number of concurrent workers (default 0, one
+ *          per active processor; 1 scores serially).
+ *        - threshold: When set, only the rows scoring at least this much
+ *          are returned.
+ * @return One dictionary per returned row, in input order, with its
+ *         "index" in inputs, its "score" and the "meanDepth" of the row
+ *         across the trees.
+ */
+- (NSArray*)scores:(NSArray*)inputs options:(NSDictionary*)options;
+
+/**
+ * Tells whether an input scores at least the given threshold, the same as
+ * comparing score:options: to it. Trees are evaluated one at a time, and
+ * evaluation stops as soon as the depths the remaining trees could add
+ * cannot change the outcome.
+ * @param treesEvaluated When not NULL, set to the number of trees evaluated
+ */
+- (BOOL)isAnomalous:(NSDictionary*)input
+          threshold:(double)threshold
+            options:(NSDictionary*)options
+     treesEvaluated:(NSUInteger*)treesEvaluated;
+
+/**
+ * Explains the score of an input, e.g. one flagged by scores:options:.
+ * Scoring itself never builds these rules.
+ * @return One array per tree with the rules of the nodes the input flows
+ *         through below the root, in order.
+ */
+- (NSArray*)pathsForInput:(NSDictionary*)input options:(NSDictionary*)options;
+
 @end
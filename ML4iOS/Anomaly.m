@@ -8,91 +8,60 @@
 
 #import "Anomaly.h"
 #import "Predicates.h"
+#import "ModelArchive.h"
+#import "Constants.h"
 
 #define DEPTH_FACTOR 0.5772156649
 
 /**
- * Tree structure for the BigML anomaly detector
- *
- * This class defines an auxiliary tree that is used when calculating
- * anomaly scores without needing to send requests to BigML.io.
- *
+ * The expected mean depth of an input, from the size of the samples the
+ * trees were grown with
  */
-@interface AnomalyTreeNode : NSObject
-
-@property (nonatomic, strong) Anomaly* anomaly;
-@property (nonatomic, strong) Predicates* predicates;
-@property (nonatomic, strong) NSString* identifier;
-@property (nonatomic, strong) NSMutableArray* children;
-
-@end
+static double AnomalyExpectedMeanDepth(double sampleSize, double meanDepth) {
 
-@implementation AnomalyTreeNode {
-    
-    NSDictionary* _fields;
+    double defaultDepth = 2 * (DEPTH_FACTOR + log(sampleSize - 1) - ((sampleSize - 1) / sampleSize));
+    return fmin(meanDepth, defaultDepth);
 }
 
-- (instancetype)initWithTree:(NSDictionary*)tree anomaly:(Anomaly*)anomaly {
-    
-    if (self = [super init]) {
-        _anomaly = anomaly;
-        _fields = anomaly.fields;
-        _predicates = [[Predicates alloc] initWithPredicates:tree[@"predicates"]?:@[@(YES)]];
-        _identifier = tree[@"id"];
-        
-        _children = [NSMutableArray arrayWithCapacity:[tree[@"children"] count]];
-        for (id child in tree[@"children"]) {
-            [_children addObject:[[AnomalyTreeNode alloc] initWithTree:child anomaly:anomaly]];
-        }
+static NSString* AnomalyOperatorName(PredicateOperator op) {
+
+    switch (op) {
+        case PredicateOperatorLessThan:
+            return OPERATOR_LT;
+        case PredicateOperatorLessOrEqual:
+            return OPERATOR_LE;
+        case PredicateOperatorEqual:
+            return OPERATOR_EQ;
+        case PredicateOperatorNotEqual:
+            return OPERATOR_NE;
+        case PredicateOperatorGreaterOrEqual:
+            return OPERATOR_GE;
+        case PredicateOperatorGreaterThan:
+            return OPERATOR_GT;
+        default:
+            return nil;
     }
-    return self;
 }
 
 /**
- *
- * Returns the depth of the tree that the input data "verifies"
- * and the associated set of rules.
- *
- * If a node has any child whose predicates are all true for the given
- * input, then the depth is incremented and we flow through.
- * If the node has no children or no children with all valid predicates,
- * then it outputs the depth of the node.
- *
- * @return
+ * The isolation forest is compiled into the tree, node and split records of
+ * ModelArchive, so that an archived forest is scored straight from the
+ * mapped file. Numeric splits are applied from the split itself; any other
+ * predicate is delegated to the Predicate object at index `predicate`.
  */
-- (NSUInteger)verifiedDepthForTree:(NSDictionary*)tree
-                              path:(NSMutableArray*)path
-                             depth:(NSInteger)depth {
-
-    if (!path)
-        path = [NSMutableArray new];
-    if (depth == 0) {
-        if (![self.predicates apply:tree fields:_fields]) {
-            return depth;
-        }
-        ++depth;
-    }
-    for (AnomalyTreeNode* child in _children) {
-        if (_anomaly.stopped)
-            return 0;
-        if ([child.predicates apply:tree fields:_fields]) {
-            [path addObject:[child.predicates ruleWithFields:_fields label:nil]];
-            return [child verifiedDepthForTree:tree path:path depth:++depth];
-        }
-    }
-    return depth;
-}
-
-@end
-
-
 @implementation Anomaly {
     
-    NSMutableArray* _iForest;
+    //-- the compiled tables, or the mapped archive holding them
+    NSArray* _storage;
+    const ModelArchiveTree* _trees;
+    const ModelArchiveForestNode* _nodes;
+    const ModelArchiveSplit* _splits;
+    NSUInteger _splitCount;
+    NSUInteger* _remainingMinDepth;
+    NSUInteger* _remainingMaxDepth;
+    NSArray* _predicates;
 }
 
-@synthesize iForest = _iForest;
-
 - (instancetype)initWithJSONAnomaly:(NSDictionary*)anomalyDictionary {
     
     
@@ -110,62 +79,444 @@
         _inputFields = anomalyDictionary[@"input_field"];
         
         _meanDepth = [model[@"mean_depth"] doubleValue];
-        double defaultDepth = 2 * (DEPTH_FACTOR + log(_sampleSize - 1) -
-                                   ((_sampleSize - 1) / _sampleSize));
-        _expectedMeanDepth = fmin(_meanDepth, defaultDepth);
-        _iForest = [NSMutableArray arrayWithCapacity:[model[@"trees"] count]];
-        for (NSDictionary* tree in model[@"trees"]) {
-            [_iForest addObject:[[AnomalyTreeNode alloc] initWithTree:tree[@"root"] anomaly:self]];
-        }
+        _expectedMeanDepth = AnomalyExpectedMeanDepth(_sampleSize, _meanDepth);
+        [self compileForest:model[@"trees"]];
         _topAnomalies = model[@"top_anomalies"];
     }
     return self;
 }
 
-- (double)score:(NSDictionary*)input options:(NSDictionary*)options {
-
-    BOOL byName = [options[@"byName"] ?: @(NO) boolValue];
-    _stopped = false;
-    NSAssert(_iForest, @"Could not find forest info. The anomaly was possibly not completely created");
-
-    NSDictionary* filteredInput = [self filteredInputData:input byName:byName];
-    double depthSum = 0.0;
-    for (AnomalyTreeNode* tree in _iForest) {
-        depthSum += _stopped ? 0 : [tree verifiedDepthForTree:filteredInput path:nil depth:0];
+- (instancetype)initWithContentsOfFile:(NSString*)path error:(NSError**)error {
+    
+    NSDictionary* metadata = nil;
+    NSData* data = [ModelArchive mappedArchiveOfKind:ModelArchiveKindIsolationForest
+                                              atPath:path
+                                            metadata:&metadata
+                                               error:error];
+    if (!data)
+        return nil;
+    
+    if (![metadata[@"sample_size"] isKindOfClass:[NSNumber class]] ||
+        ![metadata[@"mean_depth"] isKindOfClass:[NSNumber class]] ||
+        ![metadata[@"top_anomalies"] isKindOfClass:[NSArray class]]) {
+        if (error)
+            *error = [NSError errorWithDomain:ModelArchiveErrorDomain
+                                         code:ModelArchiveErrorInvalidFormat
+                                     userInfo:@{ NSLocalizedDescriptionKey : @"Corrupted anomaly archive" }];
+        return nil;
+    }
+    
+    const ModelArchiveHeader* header = data.bytes;
+    if (self = [super initWithFields:metadata[@"fields"]]) {
+        
+        _sampleSize = [metadata[@"sample_size"] doubleValue];
+        _inputFields = (metadata[@"input_fields"] == [NSNull null]) ? nil : metadata[@"input_fields"];
+        _meanDepth = [metadata[@"mean_depth"] doubleValue];
+        _expectedMeanDepth = AnomalyExpectedMeanDepth(_sampleSize, _meanDepth);
+        _topAnomalies = metadata[@"top_anomalies"];
+        
+        _storage = @[ data ];
+        _treeCount = (NSUInteger)header->trees.count;
+        _nodeCount = (NSUInteger)header->nodes.count;
+        _splitCount = (NSUInteger)header->splits.count;
+        _trees = (const ModelArchiveTree*)((const char*)data.bytes + header->trees.offset);
+        _nodes = (const ModelArchiveForestNode*)((const char*)data.bytes + header->nodes.offset);
+        _splits = (const ModelArchiveSplit*)((const char*)data.bytes + header->splits.offset);
+        _predicates = [ModelArchive predicatesWithArchivedPredicates:metadata[@"predicates"] resource:self];
+        [self computeDepthBounds];
     }
-    double observedMeanDepth = depthSum / _iForest.count;
-    return pow(2.0, -observedMeanDepth / _expectedMeanDepth);
+    return self;
 }
 
-@end
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
+- (void)dealloc {
+    
+    free(_remainingMinDepth);
+    free(_remainingMaxDepth);
+}
 
+- (BOOL)writeToFile:(NSString*)path error:(NSError**)error {
+    
+    NSMutableDictionary* fields = [NSMutableDictionary dictionaryWithCapacity:self.fields.count];
+    for (NSString* fieldId in self.fields) {
+        [fields setObject:[ModelArchive archivedField:self.fields[fieldId]] forKey:fieldId];
+    }
+    NSMutableArray* predicates = [NSMutableArray arrayWithCapacity:_predicates.count];
+    for (Predicate* predicate in _predicates) {
+        [predicates addObject:[ModelArchive archivedPredicate:predicate]];
+    }
+    
+    //-- the tables are written as they are scored
+    return [ModelArchive writeArchiveOfKind:ModelArchiveKindIsolationForest
+                                   metadata:@{ @"fields" : fields,
+                                               @"predicates" : predicates,
+                                               @"sample_size" : @(_sampleSize),
+                                               @"mean_depth" : @(_meanDepth),
+                                               @"input_fields" : _inputFields ?: [NSNull null],
+                                               @"top_anomalies" : _topAnomalies ?: @[] }
+                                      trees:[NSData dataWithBytesNoCopy:(void*)_trees
+                                                                 length:_treeCount * sizeof(ModelArchiveTree)
+                                                           freeWhenDone:NO]
+                                      nodes:[NSData dataWithBytesNoCopy:(void*)_nodes
+                                                                 length:_nodeCount * sizeof(ModelArchiveForestNode)
+                                                           freeWhenDone:NO]
+                                    entries:[NSData data]
+                                     splits:[NSData dataWithBytesNoCopy:(void*)_splits
+                                                                 length:_splitCount * sizeof(ModelArchiveSplit)
+                                                           freeWhenDone:NO]
+                                     toFile:path
+                                      error:error];
+}
 
+/**
+ * Decodes a predicate as Predicates initWithPredicates: does
+ */
+- (Predicate*)predicateWithJSON:(id)p {
+    
+    Predicate* predicate = nil;
+    if ([p isKindOfClass:[NSString class]] || [p isKindOfClass:[NSNumber class]]) {
+        predicate = [[Predicate alloc] initWithOperator:@"TRUE" field:nil value:@YES term:nil];
+    } else if ([p isKindOfClass:[NSDictionary class]] &&
+               [p[@"op"] isKindOfClass:[NSString class]] &&
+               [p[@"field"] isKindOfClass:[NSString class]] &&
+               p[@"value"]) {
+        predicate = [[Predicate alloc] initWithOperator:p[@"op"]
+                                                  field:p[@"field"]
+                                                  value:p[@"value"]
+                                                   term:p[@"term"]];
+    }
+    NSAssert(predicate, @"Could not create predicate %@", p);
+    return predicate;
+}
 
+/**
+ * Flattens the trees into contiguous tree, node and split tables. Nodes are
+ * stored breadth-first, so the children of a node are contiguous, and
+ * indexed from the first node of their tree.
+ */
+- (void)compileForest:(NSArray*)trees {
+    
+    NSMutableData* treeTable = [NSMutableData dataWithCapacity:trees.count * sizeof(ModelArchiveTree)];
+    NSMutableData* nodeTable = [NSMutableData new];
+    NSMutableData* splitTable = [NSMutableData new];
+    NSMutableArray* predicates = [NSMutableArray new];
+    
+    for (NSDictionary* sourceTree in trees) {
+        
+        NSMutableArray* sourceNodes = [NSMutableArray arrayWithObject:sourceTree[@"root"]];
+        for (NSUInteger i = 0; i < sourceNodes.count; ++i) {
+            [sourceNodes addObjectsFromArray:sourceNodes[i][@"children"] ?: @[]];
+        }
+        ModelArchiveTree tree = { (uint32_t)(nodeTable.length / sizeof(ModelArchiveForestNode)),
+            (uint32_t)sourceNodes.count, 0, NO };
+        
+        uint32_t* depths = calloc(sourceNodes.count, sizeof(uint32_t));
+        uint32_t nextChild = 1;
+        for (NSUInteger i = 0; i < sourceNodes.count; ++i) {
+            
+            NSDictionary* source = sourceNodes[i];
+            ModelArchiveForestNode node = { 0 };
+            node.firstChild = nextChild;
+            node.childCount = (uint32_t)[source[@"children"] count];
+            nextChild += node.childCount;
+            for (uint32_t child = node.firstChild; child < nextChild; ++child) {
+                depths[child] = depths[i] + 1;
+                tree.maxDepth = MAX(tree.maxDepth, depths[child]);
+            }
+            
+            node.firstSplit = (uint32_t)(splitTable.length / sizeof(ModelArchiveSplit));
+            for (id p in source[@"predicates"]) {
+                
+                Predicate* predicate = [self predicateWithJSON:p];
+                //-- TRUE predicates do not change a conjunction
+                if (predicate.operatorCode == PredicateOperatorTrue)
+                    continue;
+                
+                [predicate prepareWithFields:self.fields];
+                [predicate bindToSchema:self.schema];
+                ModelArchiveSplit split = { 0 };
+                split.op = predicate.operatorCode;
+                split.missing = predicate.missing;
+                split.threshold = NAN;
+                split.field = MODEL_ARCHIVE_NONE;
+                split.predicate = MODEL_ARCHIVE_NONE;
+                split.numeric = (predicate.fieldIndex != NSNotFound &&
+                                 !predicate.term &&
+                                 [predicate.value isKindOfClass:[NSNumber class]] &&
+                                 split.op >= PredicateOperatorLessThan &&
+                                 split.op <= PredicateOperatorGreaterThan);
+                if (split.numeric) {
+                    split.field = (uint32_t)predicate.fieldIndex;
+                    split.threshold = [(id)predicate.value doubleValue];
+                } else {
+                    split.predicate = (uint32_t)predicates.count;
+                    [predicates addObject:predicate];
+                }
+                [splitTable appendBytes:&split length:sizeof(split)];
+                ++node.splitCount;
+            }
+            [nodeTable appendBytes:&node length:sizeof(node)];
+        }
+        free(depths);
+        [treeTable appendBytes:&tree length:sizeof(tree)];
+    }
+    
+    _storage = @[ treeTable, nodeTable, splitTable ];
+    _treeCount = trees.count;
+    _nodeCount = nodeTable.length / sizeof(ModelArchiveForestNode);
+    _splitCount = splitTable.length / sizeof(ModelArchiveSplit);
+    _trees = treeTable.bytes;
+    _nodes = nodeTable.bytes;
+    _splits = splitTable.bytes;
+    _predicates = predicates;
+    [self computeDepthBounds];
+}
 
+/**
+ * Computes, for each tree index t, the least and greatest depth sum the
+ * trees from t on can add to a score, so that threshold checks can stop
+ * as soon as their outcome is certain.
+ */
+- (void)computeDepthBounds {
+    
+    //-- children always follow their parent, so a reverse scan sees them first
+    NSUInteger* heights = calloc(MAX(_nodeCount, 1), sizeof(NSUInteger));
+    for (NSUInteger t = 0; t < _treeCount; ++t) {
+        const ModelArchiveForestNode* nodes = _nodes + _trees[t].firstNode;
+        NSUInteger* treeHeights = heights + _trees[t].firstNode;
+        for (NSUInteger i = _trees[t].nodeCount; i-- > 0;) {
+            NSUInteger height = 0;
+            for (NSUInteger child = nodes[i].firstChild; child < nodes[i].firstChild + nodes[i].childCount; ++child) {
+                height = MAX(height, treeHeights[child]);
+            }
+            treeHeights[i] = height + 1;
+        }
+    }
+    
+    _remainingMinDepth = calloc(_treeCount + 1, sizeof(NSUInteger));
+    _remainingMaxDepth = calloc(_treeCount + 1, sizeof(NSUInteger));
+    for (NSUInteger t = _treeCount; t-- > 0;) {
+        //-- a root without predicates always holds
+        NSUInteger minDepth = _nodes[_trees[t].firstNode].splitCount > 0 ? 0 : 1;
+        _remainingMinDepth[t] = _remainingMinDepth[t + 1] + minDepth;
+        _remainingMaxDepth[t] = _remainingMaxDepth[t + 1] + heights[_trees[t].firstNode];
+    }
+    free(heights);
+}
 
+/**
+ * Whether all the splits of a node hold for the bound input
+ */
+- (BOOL)node:(const ModelArchiveForestNode*)node appliesToValues:(const FieldValue*)values {
+    
+    const ModelArchiveSplit* split = &_splits[node->firstSplit];
+    const ModelArchiveSplit* last = split + node->splitCount;
+    for (; split < last; ++split) {
+        BOOL applies = split->numeric ?
+        PredicateApplyNumericToValue(split->op, split->threshold, split->missing, &values[split->field]) :
+        [(Predicate*)_predicates[split->predicate] applyToValues:values fields:self.fields];
+        if (!applies)
+            return NO;
+    }
+    return YES;
+}
 
+/**
+ * The conjunction of the splits of a node, as a readable rule. Numeric
+ * splits have no Predicate, so one is built to render them.
+ */
+- (NSString*)ruleOfNode:(const ModelArchiveForestNode*)node {
+    
+    NSMutableArray* rules = [NSMutableArray arrayWithCapacity:node->splitCount];
+    for (NSUInteger i = node->firstSplit; i < node->firstSplit + node->splitCount; ++i) {
+        
+        const ModelArchiveSplit* split = &_splits[i];
+        Predicate* predicate = nil;
+        if (split->numeric) {
+            NSString* op = AnomalyOperatorName(split->op);
+            predicate = [[Predicate alloc] initWithOperator:split->missing ? [op stringByAppendingString:@"*"] : op
+                                                      field:self.schema.fieldIds[split->field]
+                                                      value:@(split->threshold)
+                                                       term:nil];
+        } else {
+            predicate = _predicates[split->predicate];
+        }
+        [rules addObject:[predicate ruleWithFields:self.fields label:nil]];
+    }
+    return [rules componentsJoinedByString:@" and "];
+}
 
+/**
+ * Returns the depth of the tree that the input data "verifies".
+ *
+ * If a node has any child whose predicates are all true for the given
+ * input, then the depth is incremented and we flow through.
+ * If the node has no children or no children with all valid predicates,
+ * then it outputs the depth of the node. The root only counts if its own
+ * predicates hold.
+ *
+ * When a path is given, the rules of each child we flow through are added
+ * to it; otherwise nothing is allocated. Only reads the compiled forest, so
+ * it can run from several threads.
+ */
+- (NSUInteger)depthOfTree:(NSUInteger)tree
+                   values:(const FieldValue*)values
+                     path:(NSMutableArray*)path {
+    
+    const ModelArchiveForestNode* nodes = _nodes + _trees[tree].firstNode;
+    const ModelArchiveForestNode* node = &nodes[0];
+    if (![self node:node appliesToValues:values])
+        return 0;
+    
+    NSUInteger depth = 1;
+    while (node->childCount > 0) {
+        const ModelArchiveForestNode* next = NULL;
+        for (NSUInteger child = node->firstChild; child < node->firstChild + node->childCount; ++child) {
+            if ([self node:&nodes[child] appliesToValues:values]) {
+                next = &nodes[child];
+                break;
+            }
+        }
+        if (!next)
+            break;
+        if (path)
+            [path addObject:[self ruleOfNode:next]];
+        node = next;
+        ++depth;
+    }
+    return depth;
+}
 
+/**
+ * Returns the mean depth of the trees for a filtered input, bound into the
+ * given buffer of schema.count values
+ */
+- (double)meanDepthOfInput:(NSDictionary*)filteredInput values:(FieldValue*)values {
+    
+    [self.schema bindInput:filteredInput values:values];
+    
+    double depthSum = 0.0;
+    for (NSUInteger tree = 0; tree < _treeCount; ++tree) {
+        depthSum += [self depthOfTree:tree values:values path:nil];
+    }
+    return depthSum / _treeCount;
+}
 
+- (double)scoreForMeanDepth:(double)meanDepth {
+    
+    return pow(2.0, -meanDepth / _expectedMeanDepth);
+}
 
+- (double)score:(NSDictionary*)input options:(NSDictionary*)options {
 
+    BOOL byName = [options[@"byName"] ?: @(NO) boolValue];
+    NSAssert(_treeCount > 0, @"Could not find forest info. The anomaly was possibly not completely created");
 
+    NSDictionary* filteredInput = [self filteredInputData:input byName:byName];
+    FieldValue* values = FieldValuesAlloc(self.schema.count);
+    double meanDepth = [self meanDepthOfInput:filteredInput values:values];
+    free(values);
+    return [self scoreForMeanDepth:meanDepth];
+}
 
+- (BOOL)isAnomalous:(NSDictionary*)input
+          threshold:(double)threshold
+            options:(NSDictionary*)options
+     treesEvaluated:(NSUInteger*)treesEvaluated {
+    
+    BOOL byName = [options[@"byName"] ?: @(NO) boolValue];
+    NSAssert(_treeCount > 0, @"Could not find forest info. The anomaly was possibly not completely created");
+    
+    NSDictionary* filteredInput = [self filteredInputData:input byName:byName];
+    FieldValue* values = FieldValuesAlloc(self.schema.count);
+    [self.schema bindInput:filteredInput values:values];
+    
+    //-- the score decreases with depth, so the greatest possible depth sum
+    //-- gives the lowest possible score, and vice versa
+    double depthSum = 0.0;
+    NSUInteger tree = 0;
+    BOOL anomalous = NO;
+    while (tree < _treeCount) {
+        depthSum += [self depthOfTree:tree values:values path:nil];
+        ++tree;
+        if (tree == _treeCount) {
+            anomalous = [self scoreForMeanDepth:depthSum / _treeCount] >= threshold;
+        } else if ([self scoreForMeanDepth:(depthSum + _remainingMaxDepth[tree]) / _treeCount] >= threshold) {
+            anomalous = YES;
+            break;
+        } else if ([self scoreForMeanDepth:(depthSum + _remainingMinDepth[tree]) / _treeCount] < threshold) {
+            anomalous = NO;
+            break;
+        }
+    }
+    free(values);
+    if (treesEvaluated)
+        *treesEvaluated = tree;
+    return anomalous;
+}
 
+- (NSArray*)pathsForInput:(NSDictionary*)input options:(NSDictionary*)options {
+    
+    BOOL byName = [options[@"byName"] ?: @(NO) boolValue];
+    NSAssert(_treeCount > 0, @"Could not find forest info. The anomaly was possibly not completely created");
+    
+    NSDictionary* filteredInput = [self filteredInputData:input byName:byName];
+    FieldValue* values = FieldValuesAlloc(self.schema.count);
+    [self.schema bindInput:filteredInput values:values];
+    
+    NSMutableArray* paths = [NSMutableArray arrayWithCapacity:_treeCount];
+    for (NSUInteger tree = 0; tree < _treeCount; ++tree) {
+        NSMutableArray* path = [NSMutableArray new];
+        [self depthOfTree:tree values:values path:path];
+        [paths addObject:path];
+    }
+    free(values);
+    return paths;
+}
 
+- (NSArray*)scores:(NSArray*)inputs options:(NSDictionary*)options {
+    
+    BOOL byName = [options[@"byName"] ?: @(NO) boolValue];
+    NSUInteger threads = [options[@"threads"] ?: @(0) unsignedIntegerValue];
+    NSNumber* threshold = options[@"threshold"];
+    NSAssert(_treeCount > 0, @"Could not find forest info. The anomaly was possibly not completely created");
+    
+    NSUInteger count = inputs.count;
+    if (count == 0)
+        return @[];
+    
+    NSUInteger workers = threads ?: [[NSProcessInfo processInfo] activeProcessorCount];
+    workers = MAX(MIN(workers, count), 1);
+    
+    //-- each worker scores a contiguous range of rows into its own slots
+    double* meanDepths = calloc(count, sizeof(double));
+    void(^evaluate)(size_t) = ^(size_t worker) {
+        FieldValue* values = FieldValuesAlloc(self.schema.count);
+        NSUInteger last = (worker + 1) * count / workers;
+        for (NSUInteger i = worker * count / workers; i < last; ++i) {
+            @autoreleasepool {
+                meanDepths[i] = [self meanDepthOfInput:[self filteredInputData:inputs[i] byName:byName]
+                                                values:values];
+            }
+        }
+        free(values);
+    };
+    if (workers == 1) {
+        evaluate(0);
+    } else {
+        dispatch_apply(workers, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), evaluate);
+    }
+    
+    NSMutableArray* scores = [NSMutableArray arrayWithCapacity:threshold ? 0 : count];
+    for (NSUInteger i = 0; i < count; ++i) {
+        double score = [self scoreForMeanDepth:meanDepths[i]];
+        if (threshold && score < threshold.doubleValue)
+            continue;
+        [scores addObject:@{ @"index" : @(i),
+                             @"score" : @(score),
+                             @"meanDepth" : @(meanDepths[i]) }];
+    }
+    free(meanDepths);
+    return scores;
+}
 
+@end
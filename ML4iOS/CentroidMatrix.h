@@ -0,0 +1,95 @@
+// Copyright 2014-2015 BigML
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#import <Foundation/Foundation.h>
+#import "FieldSchema.h"
+
+/**
+ * A packed, read-only version of the centroids of a cluster.
+ *
+ * Scaled numeric centers are stored as an aligned field-major matrix, so
+ * the numeric part of the squared distance to every centroid is computed
+ * in one pass over contiguous rows. Each categorical field is compiled into
+ * one mask row per category, holding the squared scale for the centroids
+ * whose center differs from it, which is added as is. Text fields, the
+ * only ones left to a per-centroid loop, are skipped for centroids already
+ * farther than the nearest one found.
+ */
+@interface CentroidMatrix : NSObject
+
+@property (nonatomic, readonly) NSUInteger centroidCount;
+
+/**
+ * Whether distances satisfy the triangle inequality, as needed by
+ * nearestToValues:hint:distance2:. They do not for clusters with text
+ * fields, or whose centers lack some field.
+ */
+@property (nonatomic, readonly) BOOL metric;
+
+/**
+ * Packs the given centroids
+ * @param centroids PredictionCentroid instances
+ * @param schema The schema used to bind inputs
+ * @param scales The scale of each field, keyed by field Id
+ */
+- (instancetype)initWithCentroids:(NSArray*)centroids
+                           schema:(FieldSchema*)schema
+                           scales:(NSDictionary*)scales;
+
+/**
+ * Finds the centroid nearest to an input bound by the schema.
+ * @param termSets The array of unique input terms of each text field,
+ *                 indexed by schema (NSNull for other fields)
+ * @param distance2 When not NULL, set to the squared distance to the
+ *                  nearest centroid (INFINITY if there is none)
+ * @return The index of the nearest centroid, or NSNotFound
+ */
+- (NSUInteger)nearestToValues:(const FieldValue*)values
+                  uniqueTerms:(NSArray*)termSets
+                    distance2:(float*)distance2;
+
+/**
+ * Computes the squared distance to every centroid, in centroid order.
+ * @param distances2 A buffer of centroidCount doubles
+ */
+- (void)distances2ToValues:(const FieldValue*)values
+               uniqueTerms:(NSArray*)termSets
+                      into:(double*)distances2;
+
+/**
+ * Finds the k centroids nearest to an input, keeping the best ones found
+ * in a heap of k entries. Equally distant centroids are ordered by index.
+ * @param indexes A buffer of k centroid indexes, filled nearest first
+ * @param distances2 A buffer of k squared distances, in the same order
+ * @return The number of centroids found, i.e. the least of k and
+ *         centroidCount
+ */
+- (NSUInteger)nearest:(NSUInteger)k
+             toValues:(const FieldValue*)values
+          uniqueTerms:(NSArray*)termSets
+              indexes:(NSUInteger*)indexes
+           distances2:(double*)distances2;
+
+/**
+ * Same as nearestToValues:uniqueTerms:distance2:, for a metric matrix, but
+ * skipping the centroids that the distances between centers prove cannot
+ * be nearer than the nearest one found so far.
+ * @param hint The centroid to start from, e.g. the nearest centroid of a
+ *             similar input. Any hint gives the same result.
+ */
+- (NSUInteger)nearestToValues:(const FieldValue*)values
+                         hint:(NSUInteger)hint
+                    distance2:(float*)distance2;
+
+@end
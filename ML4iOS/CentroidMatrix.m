@@ -0,0 +1,701 @@
+// Copyright 2014-2015 BigML
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#import "CentroidMatrix.h"
+#import "PredictionCentroid.h"
+
+#define CENTROID_MATRIX_ALIGNMENT 64
+#define CENTROID_MATRIX_LANES 8
+//-- widens distance bounds to cover rounding in the distances they bound
+#define CENTROID_MATRIX_BOUND_MARGIN (1.0 + 1e-9)
+
+/**
+ * Allocates a zeroed, aligned buffer of doubles
+ */
+static double* CentroidMatrixAlloc(size_t count) {
+
+    void* buffer = NULL;
+    size_t size = MAX(count, 1) * sizeof(double);
+    if (posix_memalign(&buffer, CENTROID_MATRIX_ALIGNMENT, size) != 0)
+        return NULL;
+    memset(buffer, 0, size);
+    return buffer;
+}
+
+static const FieldValue CentroidMatrixMissingValue = { nil, NAN, NO };
+
+/**
+ * The scratch space of a query, carved out of a single aligned heap block.
+ * It is sized by the matrix, so it is never taken from the stack, which
+ * is only 512 KB on GCD worker threads. The packed distances come first,
+ * zeroed and aligned as the rows they are added to.
+ */
+typedef struct CentroidMatrixScratch {
+
+    double* packed;
+    double* scaled;
+    uint64_t* bitsets;
+    const double** masks;
+    NSUInteger* inputCounts;
+
+} CentroidMatrixScratch;
+
+/**
+ * An entry of the bounded heap used by nearest:toValues:uniqueTerms:...
+ */
+typedef struct CentroidMatrixNeighbor {
+
+    double distance2;
+    NSUInteger index;
+
+} CentroidMatrixNeighbor;
+
+/**
+ * Whether a is a worse neighbor than b: farther, or as far with a higher
+ * index, so that equal distances keep the order of the centroids
+ */
+static inline BOOL CentroidMatrixNeighborIsWorse(CentroidMatrixNeighbor a, CentroidMatrixNeighbor b) {
+
+    return a.distance2 > b.distance2 || (a.distance2 == b.distance2 && a.index > b.index);
+}
+
+/**
+ * Restores a heap whose worst neighbor is at its root, after its entry at
+ * position i was replaced by a better one
+ */
+static void CentroidMatrixSiftDown(CentroidMatrixNeighbor* heap, NSUInteger count, NSUInteger i) {
+
+    while (YES) {
+        NSUInteger worst = i;
+        NSUInteger left = 2 * i + 1;
+        NSUInteger right = left + 1;
+        if (left < count && CentroidMatrixNeighborIsWorse(heap[left], heap[worst]))
+            worst = left;
+        if (right < count && CentroidMatrixNeighborIsWorse(heap[right], heap[worst]))
+            worst = right;
+        if (worst == i)
+            return;
+        CentroidMatrixNeighbor swap = heap[i];
+        heap[i] = heap[worst];
+        heap[worst] = swap;
+        i = worst;
+    }
+}
+
+static void CentroidMatrixSiftUp(CentroidMatrixNeighbor* heap, NSUInteger i) {
+
+    while (i > 0) {
+        NSUInteger parent = (i - 1) / 2;
+        if (!CentroidMatrixNeighborIsWorse(heap[i], heap[parent]))
+            return;
+        CentroidMatrixNeighbor swap = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = swap;
+        i = parent;
+    }
+}
+
+@implementation CentroidMatrix {
+
+    //-- rows are padded to a multiple of CENTROID_MATRIX_LANES centroids
+    NSUInteger _stride;
+
+    NSUInteger _numericCount;
+    NSUInteger* _numericFields;
+    double* _numericScales;
+    BOOL* _numericComplete;
+    double* _centers;
+
+    NSUInteger _categoricalCount;
+    NSUInteger* _categoricalFields;
+    NSUInteger* _maskOffsets;
+    NSArray* _categoryRows;
+    double* _masks;
+    double* _categoryPenalties;
+    NSUInteger* _centerCategories;
+
+    NSUInteger _textCount;
+    NSUInteger* _textFields;
+    double* _textScales;
+    NSArray* _termIds;
+    NSUInteger* _wordOffsets;
+    NSUInteger _wordCount;
+    uint32_t* _centroidTerms;
+    NSUInteger* _centroidTermOffsets;
+    NSUInteger* _centroidTermCounts;
+
+    double* _centerDistances;
+    double* _halfSeparations;
+}
+
+- (instancetype)initWithCentroids:(NSArray*)centroids
+                           schema:(FieldSchema*)schema
+                           scales:(NSDictionary*)scales {
+
+    if (self = [super init]) {
+
+        _centroidCount = centroids.count;
+        _stride = (_centroidCount + CENTROID_MATRIX_LANES - 1) / CENTROID_MATRIX_LANES * CENTROID_MATRIX_LANES;
+
+        //-- the kind of each field is taken from the first center holding it
+        NSMutableArray* numericIds = [NSMutableArray array];
+        NSMutableArray* categoricalIds = [NSMutableArray array];
+        NSMutableArray* textIds = [NSMutableArray array];
+        NSMutableSet* seen = [NSMutableSet set];
+        for (PredictionCentroid* centroid in centroids) {
+            for (NSString* fieldId in [centroid.center.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+                if ([seen containsObject:fieldId])
+                    continue;
+                [seen addObject:fieldId];
+                id value = centroid.center[fieldId];
+                if ([value isKindOfClass:[NSArray class]]) {
+                    [textIds addObject:fieldId];
+                } else if ([value isKindOfClass:[NSString class]]) {
+                    [categoricalIds addObject:fieldId];
+                } else {
+                    [numericIds addObject:fieldId];
+                }
+            }
+        }
+        [self packNumericFields:numericIds centroids:centroids schema:schema scales:scales];
+        [self packCategoricalFields:categoricalIds centroids:centroids schema:schema scales:scales];
+        [self packTextFields:textIds centroids:centroids schema:schema scales:scales];
+        [self computeCenterDistances];
+    }
+    return self;
+}
+
+- (void)dealloc {
+
+    free(_numericFields);
+    free(_numericScales);
+    free(_numericComplete);
+    free(_centers);
+    free(_categoricalFields);
+    free(_maskOffsets);
+    free(_masks);
+    free(_categoryPenalties);
+    free(_centerCategories);
+    free(_textFields);
+    free(_textScales);
+    free(_wordOffsets);
+    free(_centroidTerms);
+    free(_centroidTermOffsets);
+    free(_centroidTermCounts);
+    free(_centerDistances);
+    free(_halfSeparations);
+}
+
+/**
+ * Distances between centers, and half the distance from each center to its
+ * closest neighbour. Only computed when distances are a metric: without text
+ * fields, whose cosine distance breaks the triangle inequality, and with
+ * every field present in every center.
+ */
+- (void)computeCenterDistances {
+
+    _metric = (_textCount == 0);
+    for (NSUInteger f = 0; f < _numericCount; ++f) {
+        _metric = _metric && _numericComplete[f];
+    }
+    for (NSUInteger f = 0; f < _categoricalCount; ++f) {
+        for (NSUInteger c = 0; c < _centroidCount; ++c) {
+            _metric = _metric && _centerCategories[f * _centroidCount + c] != NSNotFound;
+        }
+    }
+    if (!_metric)
+        return;
+
+    _centerDistances = calloc(MAX(_centroidCount * _centroidCount, 1), sizeof(double));
+    _halfSeparations = calloc(MAX(_centroidCount, 1), sizeof(double));
+    for (NSUInteger i = 0; i < _centroidCount; ++i) {
+        _halfSeparations[i] = INFINITY;
+    }
+    for (NSUInteger i = 0; i < _centroidCount; ++i) {
+        for (NSUInteger j = i + 1; j < _centroidCount; ++j) {
+
+            double distance2 = 0.0;
+            for (NSUInteger f = 0; f < _numericCount; ++f) {
+                double difference = _centers[f * _stride + i] - _centers[f * _stride + j];
+                distance2 += difference * difference;
+            }
+            for (NSUInteger f = 0; f < _categoricalCount; ++f) {
+                if (_centerCategories[f * _centroidCount + i] != _centerCategories[f * _centroidCount + j])
+                    distance2 += _categoryPenalties[f];
+            }
+            double distance = sqrt(distance2);
+            _centerDistances[i * _centroidCount + j] = distance;
+            _centerDistances[j * _centroidCount + i] = distance;
+            _halfSeparations[i] = MIN(_halfSeparations[i], distance / 2);
+            _halfSeparations[j] = MIN(_halfSeparations[j], distance / 2);
+        }
+    }
+}
+
+- (void)packNumericFields:(NSArray*)fieldIds
+                centroids:(NSArray*)centroids
+                   schema:(FieldSchema*)schema
+                   scales:(NSDictionary*)scales {
+
+    _numericCount = fieldIds.count;
+    _numericFields = calloc(MAX(_numericCount, 1), sizeof(NSUInteger));
+    _numericScales = calloc(MAX(_numericCount, 1), sizeof(double));
+    _numericComplete = calloc(MAX(_numericCount, 1), sizeof(BOOL));
+    _centers = CentroidMatrixAlloc(_numericCount * _stride);
+
+    for (NSUInteger f = 0; f < _numericCount; ++f) {
+
+        NSString* fieldId = fieldIds[f];
+        double scale = [scales[fieldId] doubleValue];
+        double* row = &_centers[f * _stride];
+        _numericFields[f] = [schema indexOfFieldId:fieldId];
+        _numericScales[f] = scale;
+        _numericComplete[f] = YES;
+        for (NSUInteger c = 0; c < _centroidCount; ++c) {
+            id value = [centroids[c] center][fieldId];
+            if (value) {
+                row[c] = [value doubleValue] * scale;
+            } else {
+                //-- a field missing from a center adds nothing to its distance
+                row[c] = NAN;
+                _numericComplete[f] = NO;
+            }
+        }
+    }
+}
+
+- (void)packCategoricalFields:(NSArray*)fieldIds
+                    centroids:(NSArray*)centroids
+                       schema:(FieldSchema*)schema
+                       scales:(NSDictionary*)scales {
+
+    _categoricalCount = fieldIds.count;
+    _categoricalFields = calloc(MAX(_categoricalCount, 1), sizeof(NSUInteger));
+    _maskOffsets = calloc(MAX(_categoricalCount, 1), sizeof(NSUInteger));
+    _categoryPenalties = calloc(MAX(_categoricalCount, 1), sizeof(double));
+    _centerCategories = calloc(MAX(_categoricalCount * _centroidCount, 1), sizeof(NSUInteger));
+
+    //-- each field gets a row per category found in the centers, and a last
+    //-- row for any other input, missing included
+    NSMutableArray* categoryRows = [NSMutableArray arrayWithCapacity:_categoricalCount];
+    NSUInteger rowCount = 0;
+    for (NSString* fieldId in fieldIds) {
+        NSMutableDictionary* rows = [NSMutableDictionary dictionary];
+        for (PredictionCentroid* centroid in centroids) {
+            id category = centroid.center[fieldId];
+            if (category && !rows[category])
+                rows[category] = @(rows.count);
+        }
+        [categoryRows addObject:rows];
+        rowCount += rows.count + 1;
+    }
+    _categoryRows = categoryRows;
+    _masks = CentroidMatrixAlloc(rowCount * _stride);
+
+    NSUInteger offset = 0;
+    for (NSUInteger f = 0; f < _categoricalCount; ++f) {
+
+        NSString* fieldId = fieldIds[f];
+        NSDictionary* rows = categoryRows[f];
+        double penalty = pow([scales[fieldId] doubleValue], 2);
+        _categoricalFields[f] = [schema indexOfFieldId:fieldId];
+        _maskOffsets[f] = offset;
+        _categoryPenalties[f] = penalty;
+        for (NSUInteger c = 0; c < _centroidCount; ++c) {
+            id category = [centroids[c] center][fieldId];
+            _centerCategories[f * _centroidCount + c] = category ? [rows[category] unsignedIntegerValue] : NSNotFound;
+        }
+        for (NSUInteger row = 0; row <= rows.count; ++row) {
+            double* mask = &_masks[(offset + row) * _stride];
+            for (NSUInteger c = 0; c < _centroidCount; ++c) {
+                id category = [centroids[c] center][fieldId];
+                if (category && [rows[category] unsignedIntegerValue] != row)
+                    mask[c] = penalty;
+            }
+        }
+        offset += rows.count + 1;
+    }
+}
+
+- (void)packTextFields:(NSArray*)fieldIds
+             centroids:(NSArray*)centroids
+                schema:(FieldSchema*)schema
+                scales:(NSDictionary*)scales {
+
+    _textCount = fieldIds.count;
+    _textFields = calloc(MAX(_textCount, 1), sizeof(NSUInteger));
+    _textScales = calloc(MAX(_textCount, 1), sizeof(double));
+    _wordOffsets = calloc(MAX(_textCount, 1), sizeof(NSUInteger));
+    _centroidTermOffsets = calloc(MAX(_textCount * _centroidCount, 1), sizeof(NSUInteger));
+    _centroidTermCounts = calloc(MAX(_textCount * _centroidCount, 1), sizeof(NSUInteger));
+
+    //-- the terms of each field are numbered in order of appearance, and the
+    //-- terms of each center stored as a sorted array of unique ids
+    NSMutableArray* termIds = [NSMutableArray arrayWithCapacity:_textCount];
+    NSMutableData* centroidTerms = [NSMutableData data];
+    for (NSUInteger f = 0; f < _textCount; ++f) {
+
+        NSString* fieldId = fieldIds[f];
+        _textFields[f] = [schema indexOfFieldId:fieldId];
+        _textScales[f] = [scales[fieldId] doubleValue];
+        _wordOffsets[f] = _wordCount;
+
+        NSMutableDictionary* ids = [NSMutableDictionary dictionary];
+        for (NSUInteger c = 0; c < _centroidCount; ++c) {
+
+            id terms = [centroids[c] center][fieldId];
+            NSMutableIndexSet* centerIds = [NSMutableIndexSet indexSet];
+            if ([terms isKindOfClass:[NSArray class]]) {
+                for (id term in terms) {
+                    if (!ids[term])
+                        ids[term] = @(ids.count);
+                    [centerIds addIndex:[ids[term] unsignedIntegerValue]];
+                }
+            }
+            NSUInteger slot = f * _centroidCount + c;
+            _centroidTermOffsets[slot] = centroidTerms.length / sizeof(uint32_t);
+            _centroidTermCounts[slot] = centerIds.count;
+            [centerIds enumerateIndexesUsingBlock:^(NSUInteger index, BOOL* stop) {
+                uint32_t termId = (uint32_t)index;
+                [centroidTerms appendBytes:&termId length:sizeof(termId)];
+            }];
+        }
+        [termIds addObject:ids];
+        _wordCount += (ids.count + 63) / 64;
+    }
+    _termIds = termIds;
+    _centroidTerms = malloc(MAX(centroidTerms.length, 1));
+    memcpy(_centroidTerms, centroidTerms.bytes, centroidTerms.length);
+}
+
+/**
+ * Resolves the unique input terms of every text field, once per input,
+ * into a bitset of the term ids found in the centers. The total number of
+ * unique input terms of each field goes into inputCounts.
+ */
+- (void)resolveTerms:(NSArray*)termSets
+             bitsets:(uint64_t*)bitsets
+         inputCounts:(NSUInteger*)inputCounts {
+
+    memset(bitsets, 0, MAX(_wordCount, 1) * sizeof(uint64_t));
+    for (NSUInteger f = 0; f < _textCount; ++f) {
+
+        id terms = (_textFields[f] == NSNotFound) ? nil : termSets[_textFields[f]];
+        if (![terms isKindOfClass:[NSArray class]])
+            terms = @[];
+        inputCounts[f] = [terms count];
+
+        NSDictionary* ids = _termIds[f];
+        uint64_t* bitset = &bitsets[_wordOffsets[f]];
+        for (id term in terms) {
+            NSNumber* termId = ids[term];
+            if (termId) {
+                NSUInteger index = termId.unsignedIntegerValue;
+                bitset[index / 64] |= (uint64_t)1 << (index % 64);
+            }
+        }
+    }
+}
+
+/**
+ * Returns the square of the distance defined by cosine similarity between
+ * the input terms of a text field and those of a centroid
+ */
+- (double)cosineDistance2OfField:(NSUInteger)f
+                        centroid:(NSUInteger)c
+                         bitsets:(const uint64_t*)bitsets
+                      inputCount:(NSUInteger)inputCount {
+
+    NSUInteger slot = f * _centroidCount + c;
+    NSUInteger centroidCount = _centroidTermCounts[slot];
+    double scale = _textScales[f];
+
+    if (inputCount == 0 && centroidCount == 0)
+        return 0.0;
+
+    if (inputCount == 0 || centroidCount == 0)
+        return scale * scale;
+
+    const uint64_t* bitset = &bitsets[_wordOffsets[f]];
+    const uint32_t* terms = &_centroidTerms[_centroidTermOffsets[slot]];
+    NSUInteger sharedCount = 0;
+    for (NSUInteger i = 0; i < centroidCount; ++i) {
+        sharedCount += (bitset[terms[i] / 64] >> (terms[i] % 64)) & 1;
+    }
+
+    double cosineSimilarity = sharedCount / sqrt((double)inputCount * centroidCount);
+    double similarityDistance = scale * (1 - cosineSimilarity);
+    return similarityDistance * similarityDistance;
+}
+
+/**
+ * Resolves an input, once, into its scaled numeric values and the mask row
+ * of each categorical field
+ */
+- (void)resolveValues:(const FieldValue*)values
+               scaled:(double*)scaled
+                masks:(const double**)masks {
+
+    for (NSUInteger f = 0; f < _numericCount; ++f) {
+
+        NSUInteger field = _numericFields[f];
+        const FieldValue* input = (field == NSNotFound) ? &CentroidMatrixMissingValue : &values[field];
+        scaled[f] = (input->isNumber ? input->number : [input->object doubleValue]) * _numericScales[f];
+    }
+    for (NSUInteger f = 0; f < _categoricalCount; ++f) {
+
+        NSUInteger field = _categoricalFields[f];
+        NSDictionary* rows = _categoryRows[f];
+        id category = (field == NSNotFound) ? nil : values[field].object;
+        NSNumber* row = category ? rows[category] : nil;
+        masks[f] = &_masks[(_maskOffsets[f] + (row ? row.unsignedIntegerValue : rows.count)) * _stride];
+    }
+}
+
+/**
+ * Allocates the scratch space of a query, to be released with free() of
+ * its packed distances
+ */
+- (CentroidMatrixScratch)newScratch {
+
+    NSUInteger stride = MAX(_stride, 1);
+    NSUInteger numericCount = MAX(_numericCount, 1);
+    NSUInteger wordCount = MAX(_wordCount, 1);
+    size_t size = (stride + numericCount) * sizeof(double) + wordCount * sizeof(uint64_t) +
+        MAX(_categoricalCount, 1) * sizeof(const double*) + MAX(_textCount, 1) * sizeof(NSUInteger);
+
+    CentroidMatrixScratch scratch;
+    scratch.packed = CentroidMatrixAlloc((size + sizeof(double) - 1) / sizeof(double));
+    scratch.scaled = scratch.packed + stride;
+    scratch.bitsets = (uint64_t*)(scratch.scaled + numericCount);
+    scratch.masks = (const double**)(scratch.bitsets + wordCount);
+    scratch.inputCounts = (NSUInteger*)(scratch.masks + MAX(_categoricalCount, 1));
+    return scratch;
+}
+
+/**
+ * Adds the numeric and categorical parts of the squared distance to every
+ * centroid. Both loops run over contiguous, aligned rows.
+ */
+- (void)addPackedDistances2:(double*)distances2
+                     scaled:(const double*)scaled
+                      masks:(const double**)masks {
+
+    for (NSUInteger f = 0; f < _numericCount; ++f) {
+
+        double x = scaled[f];
+        const double* row = &_centers[f * _stride];
+        if (_numericComplete[f]) {
+            for (NSUInteger c = 0; c < _stride; ++c) {
+                double difference = x - row[c];
+                distances2[c] += difference * difference;
+            }
+        } else {
+            for (NSUInteger c = 0; c < _stride; ++c) {
+                double difference = x - row[c];
+                distances2[c] += isnan(row[c]) ? 0.0 : difference * difference;
+            }
+        }
+    }
+
+    for (NSUInteger f = 0; f < _categoricalCount; ++f) {
+
+        const double* mask = masks[f];
+        for (NSUInteger c = 0; c < _stride; ++c) {
+            distances2[c] += mask[c];
+        }
+    }
+}
+
+/**
+ * The same squared distance addPackedDistances2:scaled:masks: computes,
+ * for a single centroid of a metric matrix. Terms are added in the same
+ * order, so both give the same result to the bit.
+ */
+- (double)distance2ToCentroid:(NSUInteger)c
+                       scaled:(const double*)scaled
+                        masks:(const double**)masks {
+
+    double distance2 = 0.0;
+    for (NSUInteger f = 0; f < _numericCount; ++f) {
+        double difference = scaled[f] - _centers[f * _stride + c];
+        distance2 += difference * difference;
+    }
+    for (NSUInteger f = 0; f < _categoricalCount; ++f) {
+        distance2 += masks[f][c];
+    }
+    return distance2;
+}
+
+- (NSUInteger)nearestToValues:(const FieldValue*)values
+                  uniqueTerms:(NSArray*)termSets
+                    distance2:(float*)distance2 {
+
+    CentroidMatrixScratch scratch = [self newScratch];
+    const double** masks = scratch.masks;
+    const uint64_t* bitsets = scratch.bitsets;
+    const NSUInteger* inputCounts = scratch.inputCounts;
+    const double* distances2 = scratch.packed;
+    [self resolveValues:values scaled:scratch.scaled masks:scratch.masks];
+    [self addPackedDistances2:scratch.packed scaled:scratch.scaled masks:masks];
+    [self resolveTerms:termSets bitsets:scratch.bitsets inputCounts:scratch.inputCounts];
+
+    NSUInteger nearest = NSNotFound;
+    double nearestDistance2 = INFINITY;
+    for (NSUInteger c = 0; c < _centroidCount; ++c) {
+
+        double candidate = distances2[c];
+        for (NSUInteger f = 0; f < _textCount && candidate < nearestDistance2; ++f) {
+            candidate += [self cosineDistance2OfField:f
+                                             centroid:c
+                                              bitsets:bitsets
+                                           inputCount:inputCounts[f]];
+        }
+        if (candidate < nearestDistance2) {
+            nearest = c;
+            nearestDistance2 = candidate;
+        }
+    }
+    free(scratch.packed);
+    if (distance2)
+        *distance2 = nearestDistance2;
+    return nearest;
+}
+
+- (void)distances2ToValues:(const FieldValue*)values
+               uniqueTerms:(NSArray*)termSets
+                      into:(double*)distances2 {
+
+    CentroidMatrixScratch scratch = [self newScratch];
+    const uint64_t* bitsets = scratch.bitsets;
+    const NSUInteger* inputCounts = scratch.inputCounts;
+    const double* packed = scratch.packed;
+    [self resolveValues:values scaled:scratch.scaled masks:scratch.masks];
+    [self addPackedDistances2:scratch.packed scaled:scratch.scaled masks:scratch.masks];
+    [self resolveTerms:termSets bitsets:scratch.bitsets inputCounts:scratch.inputCounts];
+
+    for (NSUInteger c = 0; c < _centroidCount; ++c) {
+        double distance2 = packed[c];
+        for (NSUInteger f = 0; f < _textCount; ++f) {
+            distance2 += [self cosineDistance2OfField:f
+                                             centroid:c
+                                              bitsets:bitsets
+                                           inputCount:inputCounts[f]];
+        }
+        distances2[c] = distance2;
+    }
+    free(scratch.packed);
+}
+
+- (NSUInteger)nearest:(NSUInteger)k
+             toValues:(const FieldValue*)values
+          uniqueTerms:(NSArray*)termSets
+              indexes:(NSUInteger*)indexes
+           distances2:(double*)distances2 {
+
+    k = MIN(k, _centroidCount);
+    if (k == 0)
+        return 0;
+
+    CentroidMatrixScratch scratch = [self newScratch];
+    const uint64_t* bitsets = scratch.bitsets;
+    const NSUInteger* inputCounts = scratch.inputCounts;
+    const double* packed = scratch.packed;
+    [self resolveValues:values scaled:scratch.scaled masks:scratch.masks];
+    [self addPackedDistances2:scratch.packed scaled:scratch.scaled masks:scratch.masks];
+    [self resolveTerms:termSets bitsets:scratch.bitsets inputCounts:scratch.inputCounts];
+
+    //-- the k best centroids so far, worst one at the root
+    CentroidMatrixNeighbor* heap = malloc(k * sizeof(CentroidMatrixNeighbor));
+    NSUInteger count = 0;
+    for (NSUInteger c = 0; c < _centroidCount; ++c) {
+
+        //-- once the heap is full, a centroid as far as its worst one loses,
+        //-- since it comes later; text distances only make it farther
+        double candidate = packed[c];
+        for (NSUInteger f = 0; f < _textCount && (count < k || candidate < heap[0].distance2); ++f) {
+            candidate += [self cosineDistance2OfField:f
+                                             centroid:c
+                                              bitsets:bitsets
+                                           inputCount:inputCounts[f]];
+        }
+        CentroidMatrixNeighbor neighbor = { candidate, c };
+        if (count < k) {
+            heap[count] = neighbor;
+            CentroidMatrixSiftUp(heap, count++);
+        } else if (CentroidMatrixNeighborIsWorse(heap[0], neighbor)) {
+            heap[0] = neighbor;
+            CentroidMatrixSiftDown(heap, count, 0);
+        }
+    }
+
+    //-- popping the worst neighbor fills the output from its end
+    for (NSUInteger i = count; i-- > 0;) {
+        indexes[i] = heap[0].index;
+        distances2[i] = heap[0].distance2;
+        heap[0] = heap[i];
+        CentroidMatrixSiftDown(heap, i, 0);
+    }
+    free(heap);
+    free(scratch.packed);
+    return count;
+}
+
+- (NSUInteger)nearestToValues:(const FieldValue*)values
+                         hint:(NSUInteger)hint
+                    distance2:(float*)distance2 {
+
+    NSAssert(_metric, @"CentroidMatrix nearestToValues:hint:distance2: distances are not a metric");
+    if (_centroidCount == 0) {
+        if (distance2)
+            *distance2 = INFINITY;
+        return NSNotFound;
+    }
+
+    CentroidMatrixScratch scratch = [self newScratch];
+    const double* scaled = scratch.scaled;
+    const double** masks = scratch.masks;
+    [self resolveValues:values scaled:scratch.scaled masks:scratch.masks];
+
+    //-- start from the hinted centroid, and prefer the lowest index among
+    //-- equally near centroids, as nearestToValues:uniqueTerms:distance2:
+    //-- does by scanning them in order
+    NSUInteger nearest = hint < _centroidCount ? hint : 0;
+    double nearestDistance2 = [self distance2ToCentroid:nearest scaled:scaled masks:masks];
+    double nearestDistance = sqrt(nearestDistance2) * CENTROID_MATRIX_BOUND_MARGIN;
+
+    //-- no other centroid is as near when we are within half the distance
+    //-- from the nearest one to its closest neighbour
+    if (nearestDistance >= _halfSeparations[nearest]) {
+        for (NSUInteger c = 0; c < _centroidCount; ++c) {
+
+            //-- by the triangle inequality, d(x, c) >= d(n, c) - d(x, n),
+            //-- so c is farther than n when d(n, c) > 2 d(x, n)
+            if (c == nearest || _centerDistances[nearest * _centroidCount + c] > 2 * nearestDistance)
+                continue;
+            double candidate = [self distance2ToCentroid:c scaled:scaled masks:masks];
+            if (candidate < nearestDistance2 || (candidate == nearestDistance2 && c < nearest)) {
+                nearest = c;
+                nearestDistance2 = candidate;
+                nearestDistance = sqrt(nearestDistance2) * CENTROID_MATRIX_BOUND_MARGIN;
+            }
+        }
+    }
+    free(scratch.packed);
+    if (distance2)
+        *distance2 = nearestDistance2;
+    return nearest;
+}
+
+@end
@@ -0,0 +1,91 @@
+// Copyright 2014-2015 BigML
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#import <Foundation/Foundation.h>
+#import "Predicates.h"
+#import "FieldSchema.h"
+
+@class PredictionTree;
+@class TreePrediction;
+
+/**
+ * A node of a CompiledTree.
+ *
+ * Nodes are stored breadth-first, so the children of a node are
+ * the contiguous range [firstChild, firstChild + childCount). The field
+ * is the index of the split field in the tree's FieldSchema.
+ */
+typedef struct CompiledTreeNode {
+
+    NSUInteger field;
+    PredicateOperator op;
+    BOOL missing;
+    BOOL numeric;
+    double threshold;
+    NSUInteger firstChild;
+    NSUInteger childCount;
+
+} CompiledTreeNode;
+
+/**
+ * A flattened, read-only version of a PredictionTree.
+ *
+ * The tree is compiled into a contiguous node table holding the field index,
+ * operator code, numeric threshold and child offsets of each node, so that
+ * the tree walk runs as a loop without message sends or allocations.
+ * Predicates that cannot be reduced to a numeric comparison (categorical,
+ * text or "in" splits) are delegated to their original Predicate.
+ */
+@interface CompiledTree : NSObject
+
+@property (nonatomic, readonly) NSUInteger nodeCount;
+@property (nonatomic, readonly) NSUInteger maxDepth;
+@property (nonatomic, readonly) NSArray* fieldIds;
+@property (nonatomic, readonly) FieldSchema* schema;
+
+/**
+ * Compiles the given tree
+ * @param tree The root of a PredictionTree
+ * @param fields The fields of the predictive model
+ * @param schema The schema used to index the fields of the model
+ */
+- (instancetype)initWithTree:(PredictionTree*)tree
+                      fields:(NSDictionary*)fields
+                      schema:(FieldSchema*)schema;
+
+/**
+ * Compiles the given tree, building a schema from the fields
+ */
+- (instancetype)initWithTree:(PredictionTree*)tree fields:(NSDictionary*)fields;
+
+/**
+ * Makes a prediction using the last prediction missing strategy. The result is
+ * the same that [PredictionTree predict:path:strategy:] would return.
+ *
+ * The input fields must be keyed by Id.
+ */
+- (TreePrediction*)predict:(NSDictionary*)inputData;
+
+/**
+ * Same as predict:, but the decision path is only recorded when withPath
+ * is YES. Its rules are rendered the first time TreePrediction.path is read.
+ */
+- (TreePrediction*)predict:(NSDictionary*)inputData withPath:(BOOL)withPath;
+
+/**
+ * Same as predict:withPath:, for an input already bound by the tree's schema
+ */
+- (TreePrediction*)predictWithValues:(const FieldValue*)values withPath:(BOOL)withPath;
+
+@end
@@ -0,0 +1,174 @@
+// Copyright 2014-2015 BigML
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#import "CompiledTree.h"
+#import "PredictionTree.h"
+#import "TreePrediction.h"
+
+@implementation CompiledTree {
+
+    CompiledTreeNode* _nodes;
+    NSArray* _sourceNodes;
+    NSArray* _predicates;
+    NSDictionary* _fields;
+}
+
+- (instancetype)initWithTree:(PredictionTree*)tree fields:(NSDictionary*)fields {
+    return [self initWithTree:tree fields:fields schema:[[FieldSchema alloc] initWithFields:fields]];
+}
+
+- (instancetype)initWithTree:(PredictionTree*)tree
+                      fields:(NSDictionary*)fields
+                      schema:(FieldSchema*)schema {
+
+    NSAssert(tree && schema, @"CompiledTree initWithTree:fields:schema: contract unfulfilled");
+
+    if (self = [super init]) {
+
+        _fields = fields;
+        _schema = schema;
+
+        //-- breadth-first order keeps siblings contiguous
+        NSMutableArray* sourceNodes = [NSMutableArray arrayWithObject:tree];
+        for (NSUInteger i = 0; i < sourceNodes.count; ++i) {
+            [sourceNodes addObjectsFromArray:[sourceNodes[i] children]];
+        }
+        _sourceNodes = sourceNodes;
+        _nodeCount = sourceNodes.count;
+        _nodes = calloc(_nodeCount, sizeof(CompiledTreeNode));
+
+        NSUInteger* depths = calloc(_nodeCount, sizeof(NSUInteger));
+        NSMutableArray* predicates = [NSMutableArray arrayWithCapacity:_nodeCount];
+        NSMutableOrderedSet* fieldIds = [NSMutableOrderedSet new];
+        NSUInteger nextChild = 1;
+
+        for (NSUInteger i = 0; i < _nodeCount; ++i) {
+
+            PredictionTree* source = sourceNodes[i];
+            Predicate* predicate = source.predicate;
+            CompiledTreeNode* node = &_nodes[i];
+
+            node->field = NSNotFound;
+            node->op = PredicateOperatorUnknown;
+            node->threshold = NAN;
+            if (predicate) {
+                [predicate bindToSchema:schema];
+                node->op = predicate.operatorCode;
+                node->missing = predicate.missing;
+                node->field = predicate.fieldIndex;
+                if (predicate.field) {
+                    [fieldIds addObject:predicate.field];
+                }
+                id value = predicate.value;
+                node->numeric = (node->field != NSNotFound &&
+                                 !predicate.term &&
+                                 [value isKindOfClass:[NSNumber class]] &&
+                                 node->op >= PredicateOperatorLessThan &&
+                                 node->op <= PredicateOperatorGreaterThan);
+                if (node->numeric) {
+                    node->threshold = [value doubleValue];
+                }
+            }
+            [predicates addObject:predicate ?: [NSNull null]];
+
+            node->firstChild = nextChild;
+            node->childCount = source.children.count;
+            nextChild += node->childCount;
+            for (NSUInteger child = node->firstChild; child < nextChild; ++child) {
+                depths[child] = depths[i] + 1;
+                _maxDepth = MAX(_maxDepth, depths[child]);
+            }
+        }
+        free(depths);
+
+        _predicates = predicates;
+        _fieldIds = fieldIds.array;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    free(_nodes);
+}
+
+/**
+ * Applies the original predicate of a node. Used for all the
+ * predicates that could not be compiled to a numeric comparison.
+ */
+- (BOOL)applyPredicateAtIndex:(NSUInteger)index values:(const FieldValue*)values {
+
+    id predicate = _predicates[index];
+    if (predicate == [NSNull null])
+        return NO;
+    return [(Predicate*)predicate applyToValues:values fields:_fields];
+}
+
+- (TreePrediction*)predict:(NSDictionary*)inputData {
+    return [self predict:inputData withPath:YES];
+}
+
+- (TreePrediction*)predict:(NSDictionary*)inputData withPath:(BOOL)withPath {
+
+    FieldValue* values = FieldValuesAlloc(_schema.count);
+    [_schema bindInput:inputData values:values];
+    TreePrediction* prediction = [self predictWithValues:values withPath:withPath];
+    free(values);
+    return prediction;
+}
+
+- (TreePrediction*)predictWithValues:(const FieldValue*)values withPath:(BOOL)withPath {
+
+    //-- the path is only collected when asked for, straight into its array
+    NSMutableArray* predicates = withPath ? [NSMutableArray arrayWithCapacity:_maxDepth] : nil;
+    NSUInteger index = 0;
+
+    while (_nodes[index].childCount > 0) {
+
+        const CompiledTreeNode* parent = &_nodes[index];
+        NSUInteger lastChild = parent->firstChild + parent->childCount;
+        NSUInteger next = NSNotFound;
+
+        for (NSUInteger child = parent->firstChild; child < lastChild; ++child) {
+
+            const CompiledTreeNode* node = &_nodes[child];
+            BOOL applies = NO;
+
+            if (node->numeric && values[node->field].isNumber) {
+                applies = PredicateCompareNumbers(node->op, values[node->field].number, node->threshold);
+            } else if (node->numeric && !values[node->field].object) {
+                applies = node->missing;
+            } else {
+                applies = [self applyPredicateAtIndex:child values:values];
+            }
+
+            if (applies) {
+                next = child;
+                break;
+            }
+        }
+        if (next == NSNotFound)
+            break;
+
+        [predicates addObject:_predicates[next]];
+        index = next;
+    }
+
+    TreePrediction* prediction = [_sourceNodes[index] predictionWithPath:nil];
+    if (withPath) {
+        [prediction setPathPredicates:predicates fields:_fields uniqueRules:NO];
+    }
+    return prediction;
+}
+
+@end
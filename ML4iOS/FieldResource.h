@@ -13,12 +13,15 @@
 // under the License.
 
 #import <Foundation/Foundation.h>
+#import "FieldSchema.h"
 
 @interface FieldResource : NSObject
 
 @property (nonatomic, strong) NSDictionary* fields;
 @property (nonatomic, readonly) NSDictionary* fieldIdByName;
 @property (nonatomic, readonly) NSDictionary* fieldNameById;
+@property (nonatomic, readonly) FieldSchema* schema;
+@property (nonatomic, readonly) NSString* objectiveFieldId;
 
 - (instancetype)initWithFields:(NSDictionary*)fields;
 
@@ -27,6 +30,11 @@
                         locale:(NSString*)locale
                  missingTokens:(NSArray*)missingTokens;
 
+/**
+ * Returns nil if the value is one of the missing tokens, the value otherwise
+ */
+- (id)normalizedValue:(id)value;
+
 - (NSDictionary*)filteredInputData:(NSDictionary*)inputData byName:(BOOL)byName;
 
 @end
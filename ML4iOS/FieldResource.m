@@ -25,10 +25,9 @@
 
 @property (nonatomic, strong) NSString* objectiveFieldId;
 @property (nonatomic, strong) NSString* objectiveFieldName;
-@property (nonatomic, strong) NSMutableArray* fieldNames;
-@property (nonatomic, strong) NSMutableArray* fieldIds;
 
 @property (nonatomic, strong) NSArray* missingTokens;
+@property (nonatomic, strong) NSSet* missingTokenSet;
 @property (nonatomic, strong) NSDictionary* invertedFields;
 @property (nonatomic, strong) NSString* locale;
 
@@ -36,8 +35,8 @@
 
 @implementation FieldResource {
     
-    NSMutableDictionary* _fieldIdByName;
-    NSMutableDictionary* _fieldNameById;
+    NSDictionary* _fieldIdByName;
+    NSDictionary* _fieldNameById;
 }
 
 @synthesize fieldIdByName = _fieldIdByName;
@@ -50,22 +49,19 @@
     
     if (self = [super init]) {
         
-        for (NSString* fieldName in fields.allKeys) {
-            NSMutableDictionary* field = fields[fieldName];
-            NSAssert(field, @"Missing field %@", fieldName);
-            NSDictionary* modelField = fields[fieldName];
-            [field setObject:modelField[@"summary"] forKey:@"summary"];
-            [field setObject:modelField[@"name"] forKey:@"name"];
-        }
-        
-        _fields = fields;
+        //-- resources with equal fields share an immutable copy of them, with
+        //-- their unique names
+        _schema = [FieldSchema sharedSchemaWithFields:fields objectiveFieldId:objectiveFieldId];
+        _fields = _schema.fields;
+        _fieldIdByName = _schema.fieldIdByName;
+        _fieldNameById = _schema.fieldNameById;
         _objectiveFieldId = objectiveFieldId;
         _locale = locale;
         if (_objectiveFieldId)
             _objectiveFieldName = _fields[_objectiveFieldId][@"name"];
-        [self makeFieldNamesUnique:_fields];
         if (!_missingTokens)
             _missingTokens = DEFAULT_MISSING_TOKENS;
+        _missingTokenSet = [NSSet setWithArray:_missingTokens];
     }
     return self;
 }
@@ -75,7 +71,7 @@
 }
 
 - (id)normalizedValue:(id)value {
-    return ([_missingTokens indexOfObject:value] != NSNotFound) ? nil : value;
+    return [_missingTokenSet containsObject:value] ? nil : value;
 }
 
 - (NSDictionary*)filteredInputData:(NSDictionary*)inputData byName:(BOOL)byName {
@@ -102,41 +98,4 @@
             model[@"object"][@"model"]);
 }
 
-- (void)addFieldId:(NSString*)fieldId name:(NSString*)name {
-    
-    [_fieldNames addObject:name];
-    [_fieldIdByName setObject:fieldId forKey:name];
-    [_fieldNameById setObject:name forKey:fieldId];
-}
-
-/**
- * Tests if the fields names are unique. If they aren't, a
- * transformation is applied to ensure unicity.
- */
-- (void)makeFieldNamesUnique:(NSDictionary*)fields {
-    
-    _fieldNames = [NSMutableArray arrayWithCapacity:fields.allKeys.count];
-    _fieldIds = [NSMutableArray arrayWithCapacity:fields.allKeys.count];
-    _fieldNameById = [NSMutableDictionary dictionaryWithCapacity:fields.allKeys.count];
-    _fieldIdByName = [NSMutableDictionary dictionaryWithCapacity:fields.allKeys.count];
-    
-    if (_objectiveFieldId) {
-        [self addFieldId:_objectiveFieldId name:fields[_objectiveFieldId][@"name"]];
-    }
-    
-    for (id fieldId in fields.allKeys) {
-        if ([_fieldIds indexOfObject:fieldId] == NSNotFound) {
-            [_fieldIds addObject:fieldId];
-            NSString* name = fields[fieldId][@"name"];
-            if ([_fieldNames indexOfObject:name] != NSNotFound) {
-                name = [NSString stringWithFormat:@"%@%@", name, fields[fieldId][@"column_number"]];
-                if ([_fieldNames indexOfObject:name] != NSNotFound) {
-                    name = [NSString stringWithFormat:@"%@%@", name, fieldId];
-                }
-            }
-            [self addFieldId:fieldId name:name];
-            [fields[fieldId] setObject:name forKey:@"name"];
-        }
-    }
-}
 @end
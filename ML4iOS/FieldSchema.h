@@ -0,0 +1,113 @@
+// Copyright 2014-2015 BigML
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#import <Foundation/Foundation.h>
+
+/**
+ * The value of a field in an input row bound by a FieldSchema.
+ *
+ * The object is not retained: it stays valid as long as the bound input
+ * dictionary does. It is nil when the field is missing from the input.
+ */
+typedef struct FieldValue {
+
+    __unsafe_unretained id object;
+    double number;
+    BOOL isNumber;
+
+} FieldValue;
+
+/**
+ * Binds a single input object, e.g. when filling a reused values buffer
+ */
+static inline FieldValue FieldValueWithObject(id object) {
+    
+    if ([object isKindOfClass:[NSNumber class]]) {
+        return (FieldValue){ object, [object doubleValue], YES };
+    }
+    return (FieldValue){ object, NAN, NO };
+}
+
+/**
+ * Allocates a buffer of count values, to be released with free(). Inputs
+ * are bound into heap buffers, allocated once per call or per worker and
+ * reused across rows, rather than into stack arrays sized by the schema:
+ * GCD worker threads only have 512 KB of stack, which a wide schema could
+ * exhaust.
+ */
+static inline FieldValue* FieldValuesAlloc(NSUInteger count) {
+    
+    return malloc(MAX(count, 1) * sizeof(FieldValue));
+}
+
+/**
+ * Maps the field ids of a model to small integer indexes.
+ *
+ * The schema is built once, when the model is loaded. Predictors then bind
+ * each input row into a dense array of FieldValue, indexed by field, so that
+ * their inner loops never hash field id strings.
+ */
+@interface FieldSchema : NSObject
+
+@property (nonatomic, readonly) NSArray* fieldIds;
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic, readonly) NSDictionary* fields;
+@property (nonatomic, readonly) NSString* objectiveFieldId;
+
+/**
+ * Maps between field ids and unique field names. Only resolved by
+ * initWithFields:objectiveFieldId:, nil otherwise.
+ */
+@property (nonatomic, readonly) NSDictionary* fieldIdByName;
+@property (nonatomic, readonly) NSDictionary* fieldNameById;
+
+/**
+ * Builds the schema of the given fields. Field ids are indexed in sorted
+ * order, so the same fields always get the same indexes.
+ * @param fields The fields of the model, keyed by id
+ */
+- (instancetype)initWithFields:(NSDictionary*)fields;
+
+/**
+ * Builds the schema of the given fields and resolves their names. Names
+ * are made unique: a field whose name is already taken gets its column
+ * number, and then its id, appended. The given fields are not modified:
+ * the schema's fields hold a renamed copy of such fields.
+ * @param fields The fields of the model, keyed by id
+ * @param objectiveFieldId The objective field, which keeps its name
+ */
+- (instancetype)initWithFields:(NSDictionary*)fields objectiveFieldId:(NSString*)objectiveFieldId;
+
+/**
+ * Returns the schema for the given fields, shared by all the live
+ * resources built from equal fields (e.g. the members of an ensemble, or
+ * repeated loads of a model), so that their metadata is kept only once.
+ * Shared schemas are looked up by a hash of the raw fields, and only built
+ * when none matches, from an immutable deep copy of the fields.
+ */
++ (FieldSchema*)sharedSchemaWithFields:(NSDictionary*)fields objectiveFieldId:(NSString*)objectiveFieldId;
+
+/**
+ * Returns the index of a field id, or NSNotFound if it is not in the schema
+ */
+- (NSUInteger)indexOfFieldId:(NSString*)fieldId;
+
+/**
+ * Binds an input row to a dense array of values.
+ * @param input The input data, keyed by field id. Unknown ids are ignored
+ * @param values An array of (at least) count values to be filled
+ */
+- (void)bindInput:(NSDictionary*)input values:(FieldValue*)values;
+
+@end
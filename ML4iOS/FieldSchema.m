@@ -0,0 +1,188 @@
+// Copyright 2014-2015 BigML
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#import "FieldSchema.h"
+
+/**
+ * Returns an immutable copy of a JSON value, nested containers included
+ */
+static id FieldSchemaFrozenCopy(id object) {
+    
+    if ([object isKindOfClass:[NSDictionary class]]) {
+        NSMutableDictionary* copy = [NSMutableDictionary dictionaryWithCapacity:[object count]];
+        for (id key in object) {
+            [copy setObject:FieldSchemaFrozenCopy(object[key]) forKey:key];
+        }
+        return [copy copy];
+    }
+    if ([object isKindOfClass:[NSArray class]]) {
+        NSMutableArray* copy = [NSMutableArray arrayWithCapacity:[object count]];
+        for (id element in object) {
+            [copy addObject:FieldSchemaFrozenCopy(element)];
+        }
+        return [copy copy];
+    }
+    return [object copy];
+}
+
+@implementation FieldSchema {
+    
+    NSDictionary* _indexes;
+    //-- the fields as given, before their names were made unique
+    NSDictionary* _sourceFields;
+}
+
+- (instancetype)initWithFields:(NSDictionary*)fields {
+    
+    if (self = [super init]) {
+        
+        _fields = fields;
+        _sourceFields = fields;
+        _fieldIds = [fields.allKeys sortedArrayUsingSelector:@selector(compare:)];
+        _count = _fieldIds.count;
+        
+        NSMutableDictionary* indexes = [NSMutableDictionary dictionaryWithCapacity:_count];
+        for (NSUInteger i = 0; i < _count; ++i) {
+            [indexes setObject:@(i) forKey:_fieldIds[i]];
+        }
+        _indexes = indexes;
+    }
+    return self;
+}
+
+- (instancetype)initWithFields:(NSDictionary*)fields objectiveFieldId:(NSString*)objectiveFieldId {
+    
+    if (self = [self initWithFields:fields]) {
+        
+        _objectiveFieldId = objectiveFieldId;
+        [self makeFieldNamesUnique];
+    }
+    return self;
+}
+
+/**
+ * Resolves a unique name for each field. The objective field goes first,
+ * then the rest in id order, so equal fields always get the same names.
+ * Renamed fields are replaced by copies holding their new name.
+ */
+- (void)makeFieldNamesUnique {
+    
+    NSMutableDictionary* fieldIdByName = [NSMutableDictionary dictionaryWithCapacity:_count];
+    NSMutableDictionary* fieldNameById = [NSMutableDictionary dictionaryWithCapacity:_count];
+    NSMutableDictionary* renamedFields = nil;
+    
+    NSString* objectiveName = _objectiveFieldId ? _fields[_objectiveFieldId][@"name"] : nil;
+    if (objectiveName) {
+        [fieldIdByName setObject:_objectiveFieldId forKey:objectiveName];
+        [fieldNameById setObject:objectiveName forKey:_objectiveFieldId];
+    }
+    
+    for (NSString* fieldId in _fieldIds) {
+        
+        NSString* name = _fields[fieldId][@"name"];
+        if (fieldNameById[fieldId] || !name)
+            continue;
+        if (fieldIdByName[name]) {
+            name = [NSString stringWithFormat:@"%@%@", name, _fields[fieldId][@"column_number"]];
+            if (fieldIdByName[name]) {
+                name = [NSString stringWithFormat:@"%@%@", name, fieldId];
+            }
+            NSMutableDictionary* field = [_fields[fieldId] mutableCopy];
+            [field setObject:name forKey:@"name"];
+            renamedFields = renamedFields ?: [_fields mutableCopy];
+            [renamedFields setObject:[field copy] forKey:fieldId];
+        }
+        [fieldIdByName setObject:fieldId forKey:name];
+        [fieldNameById setObject:name forKey:fieldId];
+    }
+    if (renamedFields)
+        _fields = [renamedFields copy];
+    _fieldIdByName = fieldIdByName;
+    _fieldNameById = fieldNameById;
+}
+
+/**
+ * Hashes the content that identifies raw fields: their ids, names and
+ * types. Fields are combined by addition, so their order does not matter.
+ */
++ (NSUInteger)hashOfFields:(NSDictionary*)fields objectiveFieldId:(NSString*)objectiveFieldId {
+    
+    NSUInteger hash = objectiveFieldId.hash;
+    for (NSString* fieldId in fields) {
+        NSDictionary* field = fields[fieldId];
+        hash += fieldId.hash * 31 + ([field[@"name"] hash] ^ ([field[@"optype"] hash] << 1));
+    }
+    return hash;
+}
+
+/**
+ * Whether the schema was built from the given raw fields
+ */
+- (BOOL)hasSourceFields:(NSDictionary*)fields objectiveFieldId:(NSString*)objectiveFieldId {
+    
+    return ((_objectiveFieldId == objectiveFieldId || [_objectiveFieldId isEqualToString:objectiveFieldId]) &&
+            (_sourceFields == fields || [_sourceFields isEqualToDictionary:fields]));
+}
+
++ (FieldSchema*)sharedSchemaWithFields:(NSDictionary*)fields objectiveFieldId:(NSString*)objectiveFieldId {
+    
+    static NSMapTable* sharedSchemas = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        //-- entries go away with the last resource using them
+        sharedSchemas = [NSMapTable strongToWeakObjectsMapTable];
+    });
+    
+    //-- the raw fields are only compared on a hash hit, and only copied and
+    //-- given unique names on a miss
+    NSNumber* hash = @([self hashOfFields:fields objectiveFieldId:objectiveFieldId]);
+    @synchronized(sharedSchemas) {
+        FieldSchema* schema = [sharedSchemas objectForKey:hash];
+        if ([schema hasSourceFields:fields objectiveFieldId:objectiveFieldId])
+            return schema;
+    }
+    
+    FieldSchema* schema = [[FieldSchema alloc] initWithFields:FieldSchemaFrozenCopy(fields)
+                                             objectiveFieldId:objectiveFieldId];
+    @synchronized(sharedSchemas) {
+        //-- another thread may have built the same schema meanwhile
+        FieldSchema* sharedSchema = [sharedSchemas objectForKey:hash];
+        if ([sharedSchema hasSourceFields:fields objectiveFieldId:objectiveFieldId])
+            return sharedSchema;
+        //-- on a collision, the latest schema is the one shared from now on
+        [sharedSchemas setObject:schema forKey:hash];
+    }
+    return schema;
+}
+
+- (NSUInteger)indexOfFieldId:(NSString*)fieldId {
+    
+    NSNumber* index = fieldId ? _indexes[fieldId] : nil;
+    return index ? [index unsignedIntegerValue] : NSNotFound;
+}
+
+- (void)bindInput:(NSDictionary*)input values:(FieldValue*)values {
+    
+    for (NSUInteger i = 0; i < _count; ++i) {
+        values[i] = (FieldValue){ nil, NAN, NO };
+    }
+    for (NSString* fieldId in input) {
+        NSNumber* index = _indexes[fieldId];
+        if (index) {
+            values[[index unsignedIntegerValue]] = FieldValueWithObject(input[fieldId]);
+        }
+    }
+}
+
+@end
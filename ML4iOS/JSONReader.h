@@ -0,0 +1,77 @@
+// Copyright 2014-2015 BigML
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#import <Foundation/Foundation.h>
+
+extern NSString* const JSONReaderErrorDomain;
+
+/**
+ * Makes an object out of a JSON object as soon as it is read. Returns nil if
+ * the object is not valid, which fails the whole document.
+ */
+typedef id (^JSONReaderBuilder)(NSMutableDictionary* object);
+
+/**
+ * A JSON reader that only builds the parts of a document it is asked for.
+ *
+ * The document is scanned straight from its bytes, in a single pass, and
+ * every value not selected by the `keeping` specification is skipped without
+ * allocating anything. Selected values are built as mutable containers, like
+ * NSJSONSerialization does with NSJSONReadingMutableContainers.
+ *
+ * A specification is either:
+ *
+ *      - @YES: keep the whole value.
+ *      - An NSDictionary: for objects, keep only the keys it holds, each one
+ *        filtered by its own specification. The key @"*" applies to any key
+ *        not listed. For arrays, each element is filtered by the dictionary.
+ *      - A specification made by specification:building:, which filters
+ *        objects as the specification it wraps and then replaces them by
+ *        what its builder returns. Objects nested in them are built first,
+ *        so a recursive structure is built bottom-up while it is read.
+ */
+@interface JSONReader : NSObject
+
+/**
+ * Reads the selected parts of a JSON document.
+ * @param data The UTF-8 bytes of the document
+ * @param spec What to keep, see above
+ * @param error Set when the document is not valid JSON
+ * @return The selected parts of the document, or nil on error
+ */
++ (id)objectWithData:(NSData*)data
+             keeping:(id)spec
+               error:(NSError**)error;
+
+/**
+ * The specification of the parts of a BigML model resource used by
+ * PredictiveModel: status, objective field, fields metadata, importance
+ * and the tree nodes, without the field summaries and dataset details.
+ */
++ (NSDictionary*)modelSpecification;
+
+/**
+ * The same as modelSpecification, but every tree node is replaced by what
+ * the builder makes of it. The "children" of the objects given to the
+ * builder already hold the built children.
+ */
++ (NSDictionary*)modelSpecificationWithNodeBuilder:(JSONReaderBuilder)builder;
+
+/**
+ * Wraps a specification so that the objects it selects are built as soon
+ * as they are read.
+ */
++ (id)specification:(id)spec building:(JSONReaderBuilder)builder;
+
+@end
@@ -0,0 +1,477 @@
+// Copyright 2014-2015 BigML
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#import "JSONReader.h"
+#import <ctype.h>
+#import <errno.h>
+
+NSString* const JSONReaderErrorDomain = @"JSONReaderErrorDomain";
+
+//-- each level of a tree takes two levels of nesting (node and children)
+#define JSON_READER_MAX_DEPTH 2048
+
+/**
+ * The position of the reader in the document. Parsing stops at the first
+ * error, whose description is kept in `error`.
+ */
+typedef struct JSONReaderState {
+
+    const uint8_t* cursor;
+    const uint8_t* end;
+    const char* error;
+
+} JSONReaderState;
+
+/**
+ * A specification whose objects are replaced by what its builder makes of
+ * them once they are read
+ */
+@interface JSONReaderBuildingSpecification : NSObject
+
+@property (nonatomic, strong) id specification;
+@property (nonatomic, copy) JSONReaderBuilder builder;
+
+@end
+
+@implementation JSONReaderBuildingSpecification
+@end
+
+static id JSONReaderValue(JSONReaderState* s, id spec, NSUInteger depth);
+
+static inline void JSONReaderSkipSpace(JSONReaderState* s) {
+
+    while (s->cursor < s->end &&
+           (*s->cursor == ' ' || *s->cursor == '\n' || *s->cursor == '\r' || *s->cursor == '\t')) {
+        ++s->cursor;
+    }
+}
+
+static inline id JSONReaderFail(JSONReaderState* s, const char* error) {
+
+    if (!s->error) {
+        s->error = error;
+    }
+    return nil;
+}
+
+static inline int JSONReaderHexValue(uint8_t c) {
+
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * Reads the four hex digits of a \u escape, or returns -1
+ */
+static int JSONReaderCodeUnit(const uint8_t* p) {
+
+    int unit = 0;
+    for (int i = 0; i < 4; ++i) {
+        int digit = JSONReaderHexValue(p[i]);
+        if (digit < 0)
+            return -1;
+        unit = (unit << 4) | digit;
+    }
+    return unit;
+}
+
+static uint8_t* JSONReaderAppendCodePoint(uint8_t* out, uint32_t c) {
+
+    if (c < 0x80) {
+        *out++ = c;
+    } else if (c < 0x800) {
+        *out++ = 0xC0 | (c >> 6);
+        *out++ = 0x80 | (c & 0x3F);
+    } else if (c < 0x10000) {
+        *out++ = 0xE0 | (c >> 12);
+        *out++ = 0x80 | ((c >> 6) & 0x3F);
+        *out++ = 0x80 | (c & 0x3F);
+    } else {
+        *out++ = 0xF0 | (c >> 18);
+        *out++ = 0x80 | ((c >> 12) & 0x3F);
+        *out++ = 0x80 | ((c >> 6) & 0x3F);
+        *out++ = 0x80 | (c & 0x3F);
+    }
+    return out;
+}
+
+/**
+ * Decodes the escapes of a string body. Escapes never take less room than
+ * what they decode to, so `out` needs at most `length` bytes.
+ */
+static NSUInteger JSONReaderUnescape(const uint8_t* p, NSUInteger length, uint8_t* out) {
+
+    const uint8_t* end = p + length;
+    uint8_t* start = out;
+    while (p < end) {
+        if (*p != '\\') {
+            *out++ = *p++;
+            continue;
+        }
+        uint8_t escape = p[1];
+        p += 2;
+        switch (escape) {
+            case 'b': *out++ = '\b'; break;
+            case 'f': *out++ = '\f'; break;
+            case 'n': *out++ = '\n'; break;
+            case 'r': *out++ = '\r'; break;
+            case 't': *out++ = '\t'; break;
+            case 'u': {
+                uint32_t c = JSONReaderCodeUnit(p);
+                p += 4;
+                if (c >= 0xD800 && c <= 0xDBFF && p + 6 <= end && p[0] == '\\' && p[1] == 'u') {
+                    int low = JSONReaderCodeUnit(p + 2);
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                        p += 6;
+                    }
+                }
+                //-- lone surrogates cannot be encoded in UTF-8
+                if (c >= 0xD800 && c <= 0xDFFF) {
+                    c = 0xFFFD;
+                }
+                out = JSONReaderAppendCodePoint(out, c);
+                break;
+            }
+            default:
+                *out++ = escape;
+                break;
+        }
+    }
+    return out - start;
+}
+
+/**
+ * Reads a string, with the cursor on its opening quote. The string is only
+ * built when `build` is YES; otherwise the result is just non nil on success.
+ */
+static id JSONReaderString(JSONReaderState* s, BOOL build) {
+
+    const uint8_t* start = ++s->cursor;
+    BOOL escaped = NO;
+    while (s->cursor < s->end && *s->cursor != '"') {
+        if (*s->cursor < 0x20)
+            return JSONReaderFail(s, "Control character in string");
+        if (*s->cursor == '\\') {
+            escaped = YES;
+            if (s->cursor + 1 >= s->end)
+                break;
+            if (s->cursor[1] == 'u') {
+                if (s->end - s->cursor < 6 || JSONReaderCodeUnit(s->cursor + 2) < 0)
+                    return JSONReaderFail(s, "Invalid unicode escape");
+                s->cursor += 4;
+            } else if (!s->cursor[1] || !strchr("\"\\/bfnrt", s->cursor[1])) {
+                return JSONReaderFail(s, "Invalid escape");
+            }
+            ++s->cursor;
+        }
+        ++s->cursor;
+    }
+    if (s->cursor >= s->end)
+        return JSONReaderFail(s, "Unterminated string");
+
+    NSUInteger length = s->cursor - start;
+    ++s->cursor;
+    if (!build)
+        return [NSNull null];
+
+    NSString* string = nil;
+    if (!escaped) {
+        string = [[NSString alloc] initWithBytes:start length:length encoding:NSUTF8StringEncoding];
+    } else {
+        uint8_t* buffer = malloc(MAX(length, 1));
+        NSUInteger unescaped = JSONReaderUnescape(start, length, buffer);
+        string = [[NSString alloc] initWithBytesNoCopy:buffer
+                                                length:unescaped
+                                              encoding:NSUTF8StringEncoding
+                                          freeWhenDone:YES];
+        if (!string) {
+            free(buffer);
+        }
+    }
+    return string ?: JSONReaderFail(s, "Invalid UTF-8 in string");
+}
+
+static id JSONReaderNumber(JSONReaderState* s, BOOL build) {
+
+    const uint8_t* start = s->cursor;
+    BOOL integer = YES;
+    if (s->cursor < s->end && *s->cursor == '-')
+        ++s->cursor;
+    const uint8_t* digits = s->cursor;
+    while (s->cursor < s->end && isdigit(*s->cursor))
+        ++s->cursor;
+    if (s->cursor == digits)
+        return JSONReaderFail(s, "Invalid number");
+    if (s->cursor < s->end && *s->cursor == '.') {
+        integer = NO;
+        digits = ++s->cursor;
+        while (s->cursor < s->end && isdigit(*s->cursor))
+            ++s->cursor;
+        if (s->cursor == digits)
+            return JSONReaderFail(s, "Invalid number");
+    }
+    if (s->cursor < s->end && (*s->cursor == 'e' || *s->cursor == 'E')) {
+        integer = NO;
+        ++s->cursor;
+        if (s->cursor < s->end && (*s->cursor == '+' || *s->cursor == '-'))
+            ++s->cursor;
+        digits = s->cursor;
+        while (s->cursor < s->end && isdigit(*s->cursor))
+            ++s->cursor;
+        if (s->cursor == digits)
+            return JSONReaderFail(s, "Invalid number");
+    }
+    if (!build)
+        return [NSNull null];
+
+    //-- strtod and strtoll need a terminated copy
+    NSUInteger length = s->cursor - start;
+    char small[64];
+    char* text = (length < sizeof(small)) ? small : malloc(length + 1);
+    memcpy(text, start, length);
+    text[length] = '\0';
+
+    NSNumber* number = nil;
+    if (integer) {
+        errno = 0;
+        long long value = strtoll(text, NULL, 10);
+        number = (errno == ERANGE) ? @(strtod(text, NULL)) : @(value);
+    } else {
+        number = @(strtod(text, NULL));
+    }
+    if (text != small) {
+        free(text);
+    }
+    return number;
+}
+
+static id JSONReaderLiteral(JSONReaderState* s, const char* literal, id value) {
+
+    size_t length = strlen(literal);
+    if ((size_t)(s->end - s->cursor) < length || memcmp(s->cursor, literal, length) != 0)
+        return JSONReaderFail(s, "Invalid literal");
+    s->cursor += length;
+    return value;
+}
+
+static id JSONReaderBuild(JSONReaderState* s, JSONReaderBuilder builder, NSMutableDictionary* object) {
+
+    if (!builder)
+        return object ?: [NSNull null];
+    id built = builder(object);
+    return built ?: JSONReaderFail(s, "Invalid object");
+}
+
+static id JSONReaderObject(JSONReaderState* s, id spec, NSUInteger depth) {
+
+    JSONReaderBuilder builder = nil;
+    if ([spec isKindOfClass:[JSONReaderBuildingSpecification class]]) {
+        builder = [spec builder];
+        spec = [spec specification];
+    }
+    BOOL filtered = [spec isKindOfClass:[NSDictionary class]];
+    NSMutableDictionary* object = spec ? [NSMutableDictionary new] : nil;
+
+    ++s->cursor;
+    JSONReaderSkipSpace(s);
+    if (s->cursor < s->end && *s->cursor == '}') {
+        ++s->cursor;
+        return JSONReaderBuild(s, builder, object);
+    }
+    while (s->cursor < s->end) {
+
+        if (*s->cursor != '"')
+            return JSONReaderFail(s, "Expected a key");
+        NSString* key = JSONReaderString(s, spec != nil);
+        if (!key)
+            return nil;
+
+        JSONReaderSkipSpace(s);
+        if (s->cursor >= s->end || *s->cursor != ':')
+            return JSONReaderFail(s, "Expected ':'");
+        ++s->cursor;
+
+        id valueSpec = !filtered ? spec : (spec[key] ?: spec[@"*"]);
+        id value = JSONReaderValue(s, valueSpec, depth + 1);
+        if (s->error)
+            return nil;
+        if (valueSpec) {
+            [object setObject:value forKey:key];
+        }
+
+        JSONReaderSkipSpace(s);
+        if (s->cursor < s->end && *s->cursor == ',') {
+            ++s->cursor;
+            JSONReaderSkipSpace(s);
+        } else if (s->cursor < s->end && *s->cursor == '}') {
+            ++s->cursor;
+            return JSONReaderBuild(s, builder, object);
+        } else {
+            break;
+        }
+    }
+    return JSONReaderFail(s, "Unterminated object");
+}
+
+static id JSONReaderArray(JSONReaderState* s, id spec, NSUInteger depth) {
+
+    NSMutableArray* array = spec ? [NSMutableArray new] : nil;
+
+    ++s->cursor;
+    JSONReaderSkipSpace(s);
+    if (s->cursor < s->end && *s->cursor == ']') {
+        ++s->cursor;
+        return array ?: [NSNull null];
+    }
+    while (s->cursor < s->end) {
+
+        id value = JSONReaderValue(s, spec, depth + 1);
+        if (s->error)
+            return nil;
+        [array addObject:value];
+
+        JSONReaderSkipSpace(s);
+        if (s->cursor < s->end && *s->cursor == ',') {
+            ++s->cursor;
+        } else if (s->cursor < s->end && *s->cursor == ']') {
+            ++s->cursor;
+            return array ?: [NSNull null];
+        } else {
+            break;
+        }
+    }
+    return JSONReaderFail(s, "Unterminated array");
+}
+
+/**
+ * Reads any value. When spec is nil the value is validated and skipped,
+ * and the result is only meaningful as a success flag.
+ */
+static id JSONReaderValue(JSONReaderState* s, id spec, NSUInteger depth) {
+
+    if (depth > JSON_READER_MAX_DEPTH)
+        return JSONReaderFail(s, "Document too deep");
+
+    JSONReaderSkipSpace(s);
+    if (s->cursor >= s->end)
+        return JSONReaderFail(s, "Unexpected end of document");
+
+    switch (*s->cursor) {
+        case '{':
+            return JSONReaderObject(s, spec, depth);
+        case '[':
+            return JSONReaderArray(s, spec, depth);
+        case '"':
+            return JSONReaderString(s, spec != nil);
+        case 't':
+            return JSONReaderLiteral(s, "true", @YES);
+        case 'f':
+            return JSONReaderLiteral(s, "false", @NO);
+        case 'n':
+            return JSONReaderLiteral(s, "null", [NSNull null]);
+        default:
+            return JSONReaderNumber(s, spec != nil);
+    }
+}
+
+@implementation JSONReader
+
++ (id)objectWithData:(NSData*)data
+             keeping:(id)spec
+               error:(NSError**)error {
+
+    NSAssert(data && spec, @"JSONReader objectWithData:keeping:error: contract unfulfilled");
+
+    JSONReaderState state = { data.bytes, (const uint8_t*)data.bytes + data.length, NULL };
+
+    //-- skip a UTF-8 byte order mark
+    if (data.length >= 3 && memcmp(state.cursor, "\xEF\xBB\xBF", 3) == 0) {
+        state.cursor += 3;
+    }
+    id object = JSONReaderValue(&state, spec, 0);
+    JSONReaderSkipSpace(&state);
+    if (!state.error && state.cursor != state.end) {
+        state.error = "Unexpected content after the document";
+    }
+    if (state.error) {
+        if (error) {
+            NSString* description = [NSString stringWithFormat:@"%s at offset %lu",
+                                     state.error, (unsigned long)(state.cursor - (const uint8_t*)data.bytes)];
+            *error = [NSError errorWithDomain:JSONReaderErrorDomain
+                                         code:0
+                                     userInfo:@{ NSLocalizedDescriptionKey : description }];
+        }
+        return nil;
+    }
+    return object;
+}
+
++ (id)specification:(id)spec building:(JSONReaderBuilder)builder {
+
+    NSAssert(spec && builder, @"JSONReader specification:building: contract unfulfilled");
+
+    JSONReaderBuildingSpecification* building = [JSONReaderBuildingSpecification new];
+    building.specification = spec;
+    building.builder = builder;
+    return building;
+}
+
++ (NSDictionary*)modelSpecification {
+
+    static NSDictionary* specification = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        specification = [self modelSpecificationWithNodeBuilder:nil];
+    });
+    return specification;
+}
+
++ (NSDictionary*)modelSpecificationWithNodeBuilder:(JSONReaderBuilder)builder {
+
+    //-- the children of a node are nodes themselves
+    NSMutableDictionary* node = [@{ @"id" : @YES,
+                                    @"output" : @YES,
+                                    @"confidence" : @YES,
+                                    @"count" : @YES,
+                                    @"distribution" : @YES,
+                                    @"objective_summary" : @YES,
+                                    @"predicate" : @YES } mutableCopy];
+    id nodeSpecification = builder ? [self specification:node building:builder] : node;
+    [node setObject:nodeSpecification forKey:@"children"];
+
+    NSDictionary* termForms = @{ @"term_forms" : @YES };
+    NSDictionary* model = @{ @"model_fields" : @{ @"*" : @{ @"*" : @YES, @"summary" : termForms } },
+                             @"fields" : @{ @"*" : @{ @"name" : @YES, @"summary" : termForms } },
+                             @"importance" : @YES,
+                             @"distribution" : @{ @"training" : @YES },
+                             @"root" : nodeSpecification };
+
+    NSMutableDictionary* resource = [@{ @"status" : @YES,
+                                        @"objective_field" : @YES,
+                                        @"objective_fields" : @YES,
+                                        @"locale" : @YES,
+                                        @"description" : @YES,
+                                        @"model" : model } mutableCopy];
+    NSMutableDictionary* document = [resource mutableCopy];
+    [document setObject:resource forKey:@"object"];
+    return document;
+}
+
+@end
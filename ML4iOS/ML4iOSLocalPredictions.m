@@ -67,6 +67,15 @@
                                              options:options];
 }
 
++ (NSArray*)localCentroidsWithJSONClusterSync:(NSDictionary*)jsonCluster
+                                         rows:(NSArray*)rows
+                                      options:(NSDictionary*)options {
+    
+    return [[[PredictiveCluster alloc] initWithCluster:jsonCluster]
+            computeNearestForRows:rows
+            options:options];
+}
+
 + (double)localScoreWithJSONAnomalySync:(NSDictionary*)jsonAnomaly
                               arguments:(NSDictionary*)args
                                 options:(NSDictionary*)options {
@@ -76,4 +85,13 @@
             options:options];
 }
 
++ (NSArray*)localScoresWithJSONAnomalySync:(NSDictionary*)jsonAnomaly
+                                      rows:(NSArray*)rows
+                                   options:(NSDictionary*)options {
+    
+    return [[[Anomaly alloc] initWithJSONAnomaly:jsonAnomaly]
+            scores:rows
+            options:options];
+}
+
 @end
@@ -14,6 +14,28 @@
 
 #import <Foundation/Foundation.h>
 
+/**
+ * Merges the bins of a histogram, sorted by point, until at most `limit` are
+ * left. Each step merges the two consecutive bins whose points are closest
+ * into a bin at their weighted mean, holding both counts. Merges happen in
+ * place and the number of bins left is returned.
+ *
+ * Runs in O(n log n) using a priority queue of the gaps between bins.
+ */
+NSUInteger ML4iOSMergeHistogramBins(double* points, double* counts, NSUInteger length, NSUInteger limit);
+
+/**
+ * Wilson score interval lower bound for a prediction whose weight is
+ * `weight` in a distribution whose weights add up to `norm`, with n
+ * instances and z the percentile of the standard normal distribution.
+ */
+double ML4iOSWilsonScore(double weight, double norm, double n, double z);
+
+/**
+ * The default percentile used in Wilson score computations
+ */
+extern const double ML4iOSWilsonScoreDefaultZ;
+
 @interface ML4iOSUtils : NSObject
 
 /**
@@ -43,7 +65,8 @@
                           andDistribution:(NSDictionary*)dist2;
 
 /**
- * Merges the bins of a regression distribution to the given limit number
+ * Merges the bins of a regression distribution, sorted by point, to the
+ * given limit number. See ML4iOSMergeHistogramBins.
  */
 + (NSArray*)mergeBins:(NSArray*)distribution limit:(NSInteger)limit;
 
@@ -131,4 +154,13 @@
  */
 + (NSDictionary*)cast:(NSDictionary*)inputData fields:(NSDictionary*)fields;
 
+/**
+ * Checks expected type of a single input value, strips affixes and casts
+ *
+ * @param value
+ * @param field
+ * @return
+ */
++ (id)castValue:(id)value field:(NSDictionary*)field;
+
 @end
@@ -18,6 +18,137 @@
 
 #define zDistributionDefault 1.96
 
+const double ML4iOSWilsonScoreDefaultZ = zDistributionDefault;
+
+double ML4iOSWilsonScore(double weight, double norm, double n, double z) {
+    
+    double p = weight;
+    if (norm != 1.0) {
+        p = p / norm;
+    }
+    double z2 = z * z;
+    double wsFactor = z2 / n;
+    double wsSqrt = sqrt((p * (1 - p) + wsFactor / 4) / n);
+    return (p + wsFactor / 2 - z * wsSqrt) / (1 + wsFactor);
+}
+
+/**
+ * An entry of the merge queue: the gap between bin `left` and the next
+ * live bin, valid as long as the version of `left` has not changed.
+ */
+typedef struct ML4iOSBinGap {
+    double gap;
+    NSUInteger left;
+    NSUInteger version;
+} ML4iOSBinGap;
+
+static inline BOOL ML4iOSBinGapPrecedes(const ML4iOSBinGap* a, const ML4iOSBinGap* b) {
+    //-- ties go to the leftmost pair, as in a linear scan
+    return a->gap < b->gap || (a->gap == b->gap && a->left < b->left);
+}
+
+static void ML4iOSBinGapPush(ML4iOSBinGap* heap, NSUInteger* size, ML4iOSBinGap entry) {
+    
+    NSUInteger index = (*size)++;
+    while (index > 0) {
+        NSUInteger parent = (index - 1) / 2;
+        if (!ML4iOSBinGapPrecedes(&entry, &heap[parent]))
+            break;
+        heap[index] = heap[parent];
+        index = parent;
+    }
+    heap[index] = entry;
+}
+
+static ML4iOSBinGap ML4iOSBinGapPop(ML4iOSBinGap* heap, NSUInteger* size) {
+    
+    ML4iOSBinGap top = heap[0];
+    ML4iOSBinGap last = heap[--(*size)];
+    NSUInteger index = 0;
+    for (;;) {
+        NSUInteger child = 2 * index + 1;
+        if (child >= *size)
+            break;
+        if (child + 1 < *size && ML4iOSBinGapPrecedes(&heap[child + 1], &heap[child]))
+            ++child;
+        if (!ML4iOSBinGapPrecedes(&heap[child], &last))
+            break;
+        heap[index] = heap[child];
+        index = child;
+    }
+    if (*size > 0)
+        heap[index] = last;
+    return top;
+}
+
+NSUInteger ML4iOSMergeHistogramBins(double* points, double* counts, NSUInteger length, NSUInteger limit) {
+    
+    if (limit < 1 || length <= limit || length < 2)
+        return length;
+    
+    //-- a single block holds the bin list links, versions and the queue,
+    //-- which gets at most 2 new entries per merge
+    NSUInteger heapCapacity = 3 * length;
+    void* block = malloc(3 * length * sizeof(NSUInteger) + heapCapacity * sizeof(ML4iOSBinGap));
+    NSUInteger* next = block;
+    NSUInteger* previous = next + length;
+    NSUInteger* versions = previous + length;
+    ML4iOSBinGap* heap = (ML4iOSBinGap*)(versions + length);
+    NSUInteger heapSize = 0;
+    
+    for (NSUInteger i = 0; i < length; ++i) {
+        next[i] = i + 1;
+        previous[i] = (i == 0) ? NSNotFound : i - 1;
+        versions[i] = 0;
+        if (i + 1 < length) {
+            ML4iOSBinGapPush(heap, &heapSize, (ML4iOSBinGap){ points[i + 1] - points[i], i, 0 });
+        }
+    }
+    
+    NSUInteger remaining = length;
+    while (remaining > limit && heapSize > 0) {
+        
+        ML4iOSBinGap entry = ML4iOSBinGapPop(heap, &heapSize);
+        NSUInteger left = entry.left;
+        if (entry.version != versions[left])
+            continue;
+        
+        NSUInteger right = next[left];
+        double count = counts[left] + counts[right];
+        points[left] = (points[left] * counts[left] + points[right] * counts[right]) / count;
+        counts[left] = count;
+        
+        //-- unlink the right bin and invalidate the gaps around the new one
+        next[left] = next[right];
+        if (next[right] < length)
+            previous[next[right]] = left;
+        versions[right] = NSNotFound;
+        ++versions[left];
+        --remaining;
+        
+        if (next[left] < length) {
+            ML4iOSBinGapPush(heap, &heapSize,
+                             (ML4iOSBinGap){ points[next[left]] - points[left], left, versions[left] });
+        }
+        NSUInteger before = previous[left];
+        if (before != NSNotFound) {
+            ++versions[before];
+            ML4iOSBinGapPush(heap, &heapSize,
+                             (ML4iOSBinGap){ points[left] - points[before], before, versions[before] });
+        }
+    }
+    
+    //-- compact the live bins, which are already sorted
+    NSUInteger count = 0;
+    for (NSUInteger i = 0; i < length; i = next[i]) {
+        points[count] = points[i];
+        counts[count] = counts[i];
+        ++count;
+    }
+    free(block);
+    return count;
+}
+
 @implementation ML4iOSUtils
 
 /**
@@ -75,40 +206,27 @@
  */
 + (NSArray*)mergeBins:(NSArray*)distribution limit:(NSInteger)limit {
     
-    NSInteger length = distribution.count;
+    NSUInteger length = distribution.count;
     if (limit < 1 || length <= limit || length < 2) {
         return  distribution;
     }
-    NSInteger indexToMerge = 2;
-    double shortest = HUGE_VAL;
-    for (NSUInteger index = 1; index < length; ++index) {
-        double distance = [[distribution[index] firstObject] doubleValue] -
-        [[distribution[index -1] firstObject] doubleValue];
-        
-        if (distance < shortest) {
-            shortest = distance;
-            indexToMerge = index;
-        }
-    }
     
-    NSMutableArray* newDistribution = [NSMutableArray arrayWithArray:
-                                       [distribution subarrayWithRange:(NSRange){0, indexToMerge-1}]];
-    NSArray* left = distribution[indexToMerge - 1];
-    NSArray* right = distribution[indexToMerge];
-    NSArray* newBin = @[@0,
-                        @(([left[0] doubleValue] * [left[1] doubleValue] +
-                           [right[0] doubleValue] * [right[1] doubleValue]) /
-                        ([left[1] doubleValue] * [right[1] doubleValue])),
-                        @1,
-                        @([left[1] longValue] * [right[1] longValue])];
-    [newDistribution addObject:newBin];
+    double* points = malloc(2 * length * sizeof(double));
+    double* counts = points + length;
+    for (NSUInteger i = 0; i < length; ++i) {
+        NSArray* bin = distribution[i];
+        points[i] = [bin.firstObject doubleValue];
+        counts[i] = [bin.lastObject doubleValue];
+    }
     
-    if (indexToMerge < length -1) {
-        [newDistribution addObjectsFromArray:
-         [distribution subarrayWithRange:(NSRange){indexToMerge+1, distribution.count - indexToMerge}]];
+    NSUInteger count = ML4iOSMergeHistogramBins(points, counts, length, limit);
+    NSMutableArray* newDistribution = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; ++i) {
+        [newDistribution addObject:@[@(points[i]), @(counts[i])]];
     }
+    free(points);
     
-    return [self mergeBins:newDistribution limit:limit];
+    return newDistribution;
 }
 
 + (NSMutableDictionary*)mergeBinsDictionary:(NSDictionary*)distribution limit:(NSInteger)limit {
@@ -201,9 +319,6 @@
                  count:(NSInteger)n
                      z:(double)z {
 
-    double z2 = 0.0;
-    double wsSqrt = 0.0;
-    double wsFactor = 0.0;
     double p = [distribution[prediction] doubleValue];
     NSAssert(p >= 0, @"Distribution weight must be a positive value");
     
@@ -211,14 +326,7 @@
     for (NSString* value in distribution.allValues) {
         norm += [value doubleValue];
     }
-    if (norm != 1.0) {
-        p = p / norm;
-    }
-
-    z2 = z * z;
-    wsFactor = z2 / n;
-    wsSqrt = sqrt((p * (1 - p) + wsFactor / 4) / n);
-    return (p + wsFactor / 2 - z * wsSqrt) / (1 + wsFactor);
+    return ML4iOSWilsonScore(p, norm, n, z);
 }
 
 + (double)wsConfidence:(id)prediction
@@ -277,16 +385,17 @@
     
     NSMutableDictionary* output = [NSMutableDictionary dictionaryWithCapacity:inputData.allKeys.count];
     for (id fieldId in inputData.allKeys) {
-        id value = inputData[fieldId];
-        NSDictionary* field = fields[fieldId];
-        NSString* opType = field[@"optype"];
-        
-        if ([opType isEqualToString:@"numeric"] && [value isKindOfClass:[NSString class]]) {
-            value = [self stripAffixesFromValue:value field:field];
-        }
-        output[fieldId] = value;
+        output[fieldId] = [self castValue:inputData[fieldId] field:fields[fieldId]];
     }
     return output;
 }
 
++ (id)castValue:(id)value field:(NSDictionary*)field {
+    
+    if ([value isKindOfClass:[NSString class]] && [field[@"optype"] isEqualToString:@"numeric"]) {
+        return [self stripAffixesFromValue:value field:field];
+    }
+    return value;
+}
+
 @end
@@ -0,0 +1,254 @@
+// Copyright 2014-2015 BigML
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#import <Foundation/Foundation.h>
+#import "FieldResource.h"
+
+@class Predicate;
+
+extern NSString* const ModelArchiveErrorDomain;
+
+//-- the index of a missing field, predicate or node
+#define MODEL_ARCHIVE_NONE UINT32_MAX
+
+typedef enum ModelArchiveError {
+
+    ModelArchiveErrorInvalidFormat,
+    ModelArchiveErrorUnsupportedVersion
+
+} ModelArchiveError;
+
+typedef enum ModelArchiveKind {
+
+    ModelArchiveKindTrees,
+    ModelArchiveKindIsolationForest
+
+} ModelArchiveKind;
+
+typedef struct ModelArchiveTable {
+
+    uint64_t offset;
+    uint64_t count;
+
+} ModelArchiveTable;
+
+/**
+ * A compact binary version of one or more decision tree models, or of the
+ * isolation forest of an Anomaly.
+ *
+ * The file holds a short header, the metadata needed to read the input
+ * (fields, categories and the predicates that are not a numeric split)
+ * and flat tables with the nodes of the trees:
+ *
+ *     ModelArchiveHeader
+ *     metadata (UTF-8 JSON, metadataLength bytes)
+ *     ModelArchiveTree[trees.count]
+ *     ModelArchiveNode[nodes.count]        (breadth-first, per tree), or
+ *     ModelArchiveForestNode[nodes.count]  for an isolation forest
+ *     ModelArchiveEntry[entries.count]     (distributions, in node order)
+ *     ModelArchiveSplit[splits.count]      (isolation forest predicates)
+ *
+ * Tables start 8-byte aligned, and those a kind does not use are empty.
+ * Loading maps the file into memory and only decodes the metadata, so
+ * predictions walk the mapped node tables directly and no PredictionTree
+ * is ever built. Tables are stored in the byte order of the writer.
+ *
+ * Clusters are not archived: their centroid matrix is rebuilt from the
+ * cluster's JSON.
+ */
+typedef struct ModelArchiveHeader {
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t kind;
+    uint32_t metadataLength;
+    ModelArchiveTable trees;
+    ModelArchiveTable nodes;
+    ModelArchiveTable entries;
+    ModelArchiveTable splits;
+
+} ModelArchiveHeader;
+
+typedef struct ModelArchiveTree {
+
+    uint32_t firstNode;
+    uint32_t nodeCount;
+    uint32_t maxDepth;
+    uint32_t isRegression;
+
+} ModelArchiveTree;
+
+/**
+ * A node of an archived tree. Children are the contiguous range
+ * [firstChild, firstChild + childCount) of the tree's nodes. The output is
+ * the predicted value for regressions, or an index in the archived
+ * categories for classifications.
+ */
+typedef struct ModelArchiveNode {
+
+    double threshold;
+    double output;
+    double confidence;
+    uint64_t count;
+    uint32_t field;
+    uint32_t predicate;
+    uint32_t firstChild;
+    uint32_t childCount;
+    uint32_t firstEntry;
+    uint32_t entryCount;
+    uint8_t op;
+    uint8_t missing;
+    uint8_t numeric;
+    uint8_t reserved[5];
+
+} ModelArchiveNode;
+
+/**
+ * An element of a node's distribution, with the confidence and probability
+ * of its category precomputed for classifications.
+ */
+typedef struct ModelArchiveEntry {
+
+    double value;
+    double count;
+    double confidence;
+    double probability;
+
+} ModelArchiveEntry;
+
+/**
+ * A node of an archived isolation forest. All of its splits, the range
+ * [firstSplit, firstSplit + splitCount) of the splits table, must hold for
+ * an input to reach it. Children are the contiguous range
+ * [firstChild, firstChild + childCount) of the tree's nodes.
+ */
+typedef struct ModelArchiveForestNode {
+
+    uint32_t firstSplit;
+    uint32_t splitCount;
+    uint32_t firstChild;
+    uint32_t childCount;
+
+} ModelArchiveForestNode;
+
+/**
+ * A predicate of an isolation forest node. Numeric splits are applied from
+ * the split itself; any other is the archived predicate at index predicate.
+ */
+typedef struct ModelArchiveSplit {
+
+    double threshold;
+    uint32_t field;
+    uint32_t predicate;
+    uint8_t op;
+    uint8_t missing;
+    uint8_t numeric;
+    uint8_t reserved[5];
+
+} ModelArchiveSplit;
+
+@interface ModelArchive : FieldResource
+
+@property (nonatomic, readonly) NSUInteger treeCount;
+
+/**
+ * Writes the given models to a binary archive.
+ * @param models PredictiveModel instances, e.g. the models of a
+ *        PredictiveModel or PredictiveEnsemble
+ * @param path The file to write
+ * @param error Set when the file could not be written
+ * @return YES if the archive was written
+ */
++ (BOOL)writeModels:(NSArray*)models
+             toFile:(NSString*)path
+              error:(NSError**)error;
+
+/**
+ * Writes an archive of any kind. The tables are written as given, and
+ * their counts derived from the record size of the kind.
+ * @param metadata The JSON metadata, which must hold the "fields" and
+ *        "predicates" the nodes refer to, and the "categories" of the
+ *        classification trees
+ */
++ (BOOL)writeArchiveOfKind:(ModelArchiveKind)kind
+                  metadata:(NSDictionary*)metadata
+                     trees:(NSData*)trees
+                     nodes:(NSData*)nodes
+                   entries:(NSData*)entries
+                    splits:(NSData*)splits
+                    toFile:(NSString*)path
+                     error:(NSError**)error;
+
+/**
+ * Maps an archive of the given kind and checks every table, node, split and
+ * entry, so that walking the mapped trees can never read out of the file.
+ * @param metadata Set to the decoded metadata
+ * @return The mapped file, starting with its ModelArchiveHeader, or nil,
+ *         setting error, if it is not a valid archive of that kind
+ */
++ (NSData*)mappedArchiveOfKind:(ModelArchiveKind)kind
+                        atPath:(NSString*)path
+                      metadata:(NSDictionary**)metadata
+                         error:(NSError**)error;
+
+/**
+ * The field as archived: only what is needed to read the input and apply
+ * the predicates
+ */
++ (NSDictionary*)archivedField:(NSDictionary*)field;
+
++ (NSDictionary*)archivedPredicate:(Predicate*)predicate;
+
+/**
+ * Rebuilds archived predicates, prepared and bound for the given resource
+ */
++ (NSArray*)predicatesWithArchivedPredicates:(NSArray*)archivedPredicates
+                                    resource:(FieldResource*)resource;
+
+/**
+ * Maps an archive written by writeModels:toFile:error:.
+ * @return nil, setting error, if the file cannot be read or is not a
+ *         valid archive
+ */
+- (instancetype)initWithContentsOfFile:(NSString*)path error:(NSError**)error;
+
+/**
+ * Makes a prediction with the first tree of the archive. Returns the same as
+ * PredictiveModel's predictWithArguments:options:, and accepts the same
+ * options, save that only the last prediction missing strategy is available
+ * and no decision path is kept.
+ * @return nil if the options ask for another missing strategy or for the
+ *         decision path
+ */
+- (NSArray*)predictWithArguments:(NSDictionary*)arguments
+                         options:(NSDictionary*)options;
+
+/**
+ * Same as predictWithArguments:options:, with the given tree of the archive,
+ * e.g. to check a single member of an archived ensemble.
+ */
+- (NSArray*)predictWithTree:(NSUInteger)treeIndex
+                  arguments:(NSDictionary*)arguments
+                    options:(NSDictionary*)options;
+
+/**
+ * Makes a prediction combining the votes of all the trees of the archive.
+ * Returns the same as PredictiveEnsemble's predictWithArguments:options:,
+ * with the same restrictions as predictWithArguments:options:, so it also
+ * returns nil for options it does not support.
+ */
+- (NSDictionary*)combinedPredictionWithArguments:(NSDictionary*)arguments
+                                         options:(NSDictionary*)options;
+
+@end
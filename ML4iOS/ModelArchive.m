@@ -0,0 +1,633 @@
+// Copyright 2014-2015 BigML
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#import "ModelArchive.h"
+#import "PredictiveModel.h"
+#import "PredictionTree.h"
+#import "TreePrediction.h"
+#import "Predicates.h"
+#import "MultiVote.h"
+#import "ML4iOSUtils.h"
+
+NSString* const ModelArchiveErrorDomain = @"ModelArchiveErrorDomain";
+
+static const uint32_t kModelArchiveMagic = 0x42344c4d; //-- "ML4B"
+static const uint32_t kModelArchiveVersion = 2;
+
+static NSError* ModelArchiveErrorWithCode(ModelArchiveError code, NSString* description) {
+
+    return [NSError errorWithDomain:ModelArchiveErrorDomain
+                               code:code
+                           userInfo:@{ NSLocalizedDescriptionKey : description }];
+}
+
+/**
+ * The record size of the node table of each kind
+ */
+static size_t ModelArchiveNodeSize(ModelArchiveKind kind) {
+
+    return kind == ModelArchiveKindIsolationForest ? sizeof(ModelArchiveForestNode) : sizeof(ModelArchiveNode);
+}
+
+/**
+ * Checks that a table lies within the file and starts 8-byte aligned
+ */
+static BOOL ModelArchiveContains(NSUInteger length, ModelArchiveTable table, size_t size) {
+
+    return (table.offset % 8 == 0 &&
+            table.offset <= length &&
+            table.count <= (length - table.offset) / size);
+}
+
+/**
+ * Checks that a classification output or distribution value is the index of
+ * one of the archived categories
+ */
+static BOOL ModelArchiveIsCategory(double value, NSUInteger categoryCount) {
+
+    return value >= 0 && value < categoryCount && floor(value) == value;
+}
+
+/**
+ * Checks that the children of a node come after it, within its tree, so
+ * that walking the tree never leaves it nor loops
+ */
+static BOOL ModelArchiveChildrenAreValid(uint32_t node, uint32_t firstChild, uint32_t childCount,
+                                         const ModelArchiveTree* tree) {
+
+    return childCount == 0 || (firstChild > node && (uint64_t)firstChild + childCount <= tree->nodeCount);
+}
+
+/**
+ * Checks that a numeric split reads a field of the schema, or that any other
+ * split has an archived predicate
+ */
+static BOOL ModelArchiveSplitIsValid(BOOL numeric, uint8_t op, uint32_t field, uint32_t predicate,
+                                     NSUInteger fieldCount, NSUInteger predicateCount) {
+
+    if (numeric)
+        return field < fieldCount && op >= PredicateOperatorLessThan && op <= PredicateOperatorGreaterThan;
+    return predicate == MODEL_ARCHIVE_NONE || predicate < predicateCount;
+}
+
+/**
+ * Checks every node of a decision tree and its distribution: fields,
+ * predicates and categories must index the archived metadata.
+ */
+static BOOL ModelArchiveTreeIsValid(const ModelArchiveTree* tree,
+                                    const ModelArchiveHeader* header,
+                                    const char* bytes,
+                                    NSDictionary* metadata) {
+
+    const ModelArchiveNode* nodes = (const ModelArchiveNode*)(bytes + header->nodes.offset) + tree->firstNode;
+    const ModelArchiveEntry* entries = (const ModelArchiveEntry*)(bytes + header->entries.offset);
+    NSUInteger fieldCount = [metadata[@"fields"] count];
+    NSUInteger predicateCount = [metadata[@"predicates"] count];
+    NSUInteger categoryCount = [metadata[@"categories"] count];
+
+    for (uint32_t n = 0; n < tree->nodeCount; ++n) {
+
+        const ModelArchiveNode* node = &nodes[n];
+        if (!ModelArchiveChildrenAreValid(n, node->firstChild, node->childCount, tree) ||
+            !ModelArchiveSplitIsValid(node->numeric, node->op, node->field, node->predicate,
+                                      fieldCount, predicateCount) ||
+            (uint64_t)node->firstEntry + node->entryCount > header->entries.count)
+            return NO;
+
+        if (!tree->isRegression) {
+            if (!ModelArchiveIsCategory(node->output, categoryCount))
+                return NO;
+            for (uint64_t e = node->firstEntry; e < (uint64_t)node->firstEntry + node->entryCount; ++e) {
+                if (!ModelArchiveIsCategory(entries[e].value, categoryCount))
+                    return NO;
+            }
+        }
+    }
+    return YES;
+}
+
+/**
+ * Checks every node of an isolation forest tree and its splits. Every split
+ * is either numeric or has a predicate, since forests drop TRUE predicates.
+ */
+static BOOL ModelArchiveForestTreeIsValid(const ModelArchiveTree* tree,
+                                          const ModelArchiveHeader* header,
+                                          const char* bytes,
+                                          NSDictionary* metadata) {
+
+    const ModelArchiveForestNode* nodes = (const ModelArchiveForestNode*)(bytes + header->nodes.offset) + tree->firstNode;
+    const ModelArchiveSplit* splits = (const ModelArchiveSplit*)(bytes + header->splits.offset);
+    NSUInteger fieldCount = [metadata[@"fields"] count];
+    NSUInteger predicateCount = [metadata[@"predicates"] count];
+
+    for (uint32_t n = 0; n < tree->nodeCount; ++n) {
+
+        const ModelArchiveForestNode* node = &nodes[n];
+        if (!ModelArchiveChildrenAreValid(n, node->firstChild, node->childCount, tree) ||
+            (uint64_t)node->firstSplit + node->splitCount > header->splits.count)
+            return NO;
+
+        for (uint64_t s = node->firstSplit; s < (uint64_t)node->firstSplit + node->splitCount; ++s) {
+            const ModelArchiveSplit* split = &splits[s];
+            if ((!split->numeric && split->predicate == MODEL_ARCHIVE_NONE) ||
+                !ModelArchiveSplitIsValid(split->numeric, split->op, split->field, split->predicate,
+                                          fieldCount, predicateCount))
+                return NO;
+        }
+    }
+    return YES;
+}
+
+@implementation ModelArchive {
+
+    NSData* _data;
+    const ModelArchiveTree* _trees;
+    const ModelArchiveNode* _nodes;
+    const ModelArchiveEntry* _entries;
+    NSArray* _categories;
+    NSArray* _predicates;
+}
+
+#pragma mark - Writing
+
++ (NSDictionary*)archivedField:(NSDictionary*)field {
+
+    NSMutableDictionary* archivedField = [NSMutableDictionary new];
+    for (NSString* key in @[ @"name", @"optype", @"column_number", @"prefix", @"suffix", @"term_analysis" ]) {
+        if (field[key]) {
+            [archivedField setObject:field[key] forKey:key];
+        }
+    }
+    NSDictionary* termForms = field[@"summary"][@"term_forms"];
+    [archivedField setObject:termForms ? @{ @"term_forms" : termForms } : @{} forKey:@"summary"];
+    return archivedField;
+}
+
++ (NSDictionary*)archivedPredicate:(Predicate*)predicate {
+
+    NSMutableDictionary* archivedPredicate = [NSMutableDictionary new];
+    [archivedPredicate setObject:predicate.missing ? [predicate.op stringByAppendingString:@"*"] : predicate.op
+                          forKey:@"operator"];
+    [archivedPredicate setObject:predicate.field forKey:@"field"];
+    if (predicate.value) {
+        [archivedPredicate setObject:predicate.value forKey:@"value"];
+    }
+    if (predicate.term) {
+        [archivedPredicate setObject:predicate.term forKey:@"term"];
+    }
+    return archivedPredicate;
+}
+
++ (uint32_t)indexOfCategory:(id)category
+                 categories:(NSMutableArray*)categories
+                    indexes:(NSMutableDictionary*)indexes {
+
+    NSNumber* index = indexes[category];
+    if (!index) {
+        index = @(categories.count);
+        [indexes setObject:index forKey:category];
+        [categories addObject:category];
+    }
+    return [index unsignedIntValue];
+}
+
++ (BOOL)writeArchiveOfKind:(ModelArchiveKind)kind
+                  metadata:(NSDictionary*)metadata
+                     trees:(NSData*)trees
+                     nodes:(NSData*)nodes
+                   entries:(NSData*)entries
+                    splits:(NSData*)splits
+                    toFile:(NSString*)path
+                     error:(NSError**)error {
+
+    NSAssert(metadata && path, @"ModelArchive writeArchiveOfKind: contract unfulfilled");
+
+    NSData* metadataData = [NSJSONSerialization dataWithJSONObject:metadata options:0 error:error];
+    if (!metadataData)
+        return NO;
+
+    //-- tables start 8-byte aligned after the metadata, and all record
+    //-- sizes are multiples of 8
+    ModelArchiveHeader header = { kModelArchiveMagic, kModelArchiveVersion, kind };
+    header.metadataLength = (uint32_t)metadataData.length;
+    header.trees = (ModelArchiveTable){ (sizeof(header) + metadataData.length + 7) & ~(uint64_t)7,
+        trees.length / sizeof(ModelArchiveTree) };
+    header.nodes = (ModelArchiveTable){ header.trees.offset + trees.length,
+        nodes.length / ModelArchiveNodeSize(kind) };
+    header.entries = (ModelArchiveTable){ header.nodes.offset + nodes.length,
+        entries.length / sizeof(ModelArchiveEntry) };
+    header.splits = (ModelArchiveTable){ header.entries.offset + entries.length,
+        splits.length / sizeof(ModelArchiveSplit) };
+
+    NSMutableData* archive = [NSMutableData dataWithCapacity:header.splits.offset + splits.length];
+    [archive appendBytes:&header length:sizeof(header)];
+    [archive appendData:metadataData];
+    [archive setLength:header.trees.offset];
+    [archive appendData:trees];
+    [archive appendData:nodes];
+    [archive appendData:entries];
+    [archive appendData:splits];
+
+    return [archive writeToFile:path options:NSDataWritingAtomic error:error];
+}
+
++ (BOOL)writeModels:(NSArray*)models
+             toFile:(NSString*)path
+              error:(NSError**)error {
+
+    NSAssert(models.count > 0 && path, @"ModelArchive writeModels:toFile:error: contract unfulfilled");
+
+    //-- all the trees share the union of the models' fields
+    NSMutableDictionary* fields = [NSMutableDictionary new];
+    for (PredictiveModel* model in models) {
+        for (NSString* fieldId in model.fields) {
+            if (!fields[fieldId]) {
+                [fields setObject:[self archivedField:model.fields[fieldId]] forKey:fieldId];
+            }
+        }
+    }
+    FieldSchema* schema = [[FieldSchema alloc] initWithFields:fields];
+
+    NSMutableArray* categories = [NSMutableArray new];
+    NSMutableDictionary* categoryIndexes = [NSMutableDictionary new];
+    NSMutableArray* predicates = [NSMutableArray new];
+    NSMutableData* trees = [NSMutableData new];
+    NSMutableData* nodes = [NSMutableData new];
+    NSMutableData* entries = [NSMutableData new];
+
+    for (PredictiveModel* model in models) {
+
+        //-- breadth-first order keeps siblings contiguous, as in CompiledTree
+        NSMutableArray* sourceNodes = [NSMutableArray arrayWithObject:model.tree];
+        for (NSUInteger i = 0; i < sourceNodes.count; ++i) {
+            [sourceNodes addObjectsFromArray:[sourceNodes[i] children]];
+        }
+        BOOL isRegression = [model.tree isRegression];
+        ModelArchiveTree tree = { (uint32_t)(nodes.length / sizeof(ModelArchiveNode)),
+            (uint32_t)sourceNodes.count, 0, isRegression };
+
+        uint32_t* depths = calloc(sourceNodes.count, sizeof(uint32_t));
+        uint32_t nextChild = 1;
+        for (NSUInteger i = 0; i < sourceNodes.count; ++i) {
+
+            PredictionTree* source = sourceNodes[i];
+            TreePrediction* prediction = [source predictionWithPath:nil];
+            Predicate* predicate = source.predicate;
+            ModelArchiveNode node = { 0 };
+
+            node.field = MODEL_ARCHIVE_NONE;
+            node.predicate = MODEL_ARCHIVE_NONE;
+            node.op = PredicateOperatorUnknown;
+            node.threshold = NAN;
+            if (predicate) {
+                NSUInteger field = [schema indexOfFieldId:predicate.field];
+                node.op = predicate.operatorCode;
+                node.missing = predicate.missing;
+                node.numeric = (field != NSNotFound &&
+                                !predicate.term &&
+                                [predicate.value isKindOfClass:[NSNumber class]] &&
+                                node.op >= PredicateOperatorLessThan &&
+                                node.op <= PredicateOperatorGreaterThan);
+                if (node.numeric) {
+                    node.field = (uint32_t)field;
+                    node.threshold = [(id)predicate.value doubleValue];
+                } else {
+                    node.predicate = (uint32_t)predicates.count;
+                    [predicates addObject:[self archivedPredicate:predicate]];
+                }
+            }
+
+            node.output = isRegression ? [prediction.prediction doubleValue] :
+            [self indexOfCategory:prediction.prediction categories:categories indexes:categoryIndexes];
+            node.confidence = prediction.confidence;
+            node.count = prediction.count;
+            node.firstEntry = (uint32_t)(entries.length / sizeof(ModelArchiveEntry));
+            node.entryCount = (uint32_t)prediction.distribution.count;
+            for (NSUInteger e = 0; e < prediction.distribution.count; ++e) {
+                NSArray* element = prediction.distribution[e];
+                ModelArchiveEntry entry = { 0 };
+                entry.value = isRegression ? [element.firstObject doubleValue] :
+                [self indexOfCategory:element.firstObject categories:categories indexes:categoryIndexes];
+                entry.count = [element.lastObject doubleValue];
+                entry.confidence = [prediction.categoryConfidences[e] doubleValue];
+                entry.probability = prediction.categoryProbabilities ?
+                [prediction.categoryProbabilities[e] doubleValue] : entry.count / prediction.count;
+                [entries appendBytes:&entry length:sizeof(entry)];
+            }
+
+            node.firstChild = nextChild;
+            node.childCount = (uint32_t)source.children.count;
+            nextChild += node.childCount;
+            for (uint32_t child = node.firstChild; child < nextChild; ++child) {
+                depths[child] = depths[i] + 1;
+                tree.maxDepth = MAX(tree.maxDepth, depths[child]);
+            }
+            [nodes appendBytes:&node length:sizeof(node)];
+        }
+        free(depths);
+        [trees appendBytes:&tree length:sizeof(tree)];
+    }
+
+    return [self writeArchiveOfKind:ModelArchiveKindTrees
+                           metadata:@{ @"fields" : fields,
+                                       @"objective_field" : [models.firstObject objectiveFieldId] ?: [NSNull null],
+                                       @"categories" : categories,
+                                       @"predicates" : predicates }
+                              trees:trees
+                              nodes:nodes
+                            entries:entries
+                             splits:[NSData data]
+                             toFile:path
+                              error:error];
+}
+
+#pragma mark - Loading
+
++ (NSData*)mappedArchiveOfKind:(ModelArchiveKind)kind
+                        atPath:(NSString*)path
+                      metadata:(NSDictionary**)metadata
+                         error:(NSError**)error {
+
+    NSData* data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedAlways error:error];
+    if (!data)
+        return nil;
+
+    const ModelArchiveHeader* header = data.bytes;
+    if (data.length < sizeof(ModelArchiveHeader) || header->magic != kModelArchiveMagic) {
+        if (error)
+            *error = ModelArchiveErrorWithCode(ModelArchiveErrorInvalidFormat, @"Not a model archive");
+        return nil;
+    }
+    if (header->version != kModelArchiveVersion) {
+        if (error)
+            *error = ModelArchiveErrorWithCode(ModelArchiveErrorUnsupportedVersion,
+                                               [NSString stringWithFormat:@"Unsupported model archive version %u",
+                                                header->version]);
+        return nil;
+    }
+    if (header->kind != kind) {
+        if (error)
+            *error = ModelArchiveErrorWithCode(ModelArchiveErrorInvalidFormat,
+                                               [NSString stringWithFormat:@"Unexpected model archive kind %u",
+                                                header->kind]);
+        return nil;
+    }
+
+    NSDictionary* decoded = nil;
+    if (ModelArchiveContains(data.length, (ModelArchiveTable){ sizeof(ModelArchiveHeader), header->metadataLength }, 1)) {
+        decoded = [NSJSONSerialization JSONObjectWithData:
+                   [data subdataWithRange:(NSRange){ sizeof(ModelArchiveHeader), header->metadataLength }]
+                                                  options:NSJSONReadingMutableContainers
+                                                    error:nil];
+    }
+    BOOL valid = ([decoded isKindOfClass:[NSDictionary class]] &&
+                  [decoded[@"fields"] isKindOfClass:[NSDictionary class]] &&
+                  [decoded[@"predicates"] isKindOfClass:[NSArray class]] &&
+                  (kind != ModelArchiveKindTrees || [decoded[@"categories"] isKindOfClass:[NSArray class]]) &&
+                  header->trees.count > 0 &&
+                  ModelArchiveContains(data.length, header->trees, sizeof(ModelArchiveTree)) &&
+                  ModelArchiveContains(data.length, header->nodes, ModelArchiveNodeSize(kind)) &&
+                  ModelArchiveContains(data.length, header->entries, sizeof(ModelArchiveEntry)) &&
+                  ModelArchiveContains(data.length, header->splits, sizeof(ModelArchiveSplit)));
+    for (NSDictionary* p in valid ? decoded[@"predicates"] : nil) {
+        valid = valid && ([p isKindOfClass:[NSDictionary class]] &&
+                          [p[@"operator"] isKindOfClass:[NSString class]] &&
+                          [p[@"field"] isKindOfClass:[NSString class]]);
+    }
+
+    const ModelArchiveTree* trees = (const ModelArchiveTree*)((const char*)data.bytes + header->trees.offset);
+    for (uint64_t i = 0; valid && i < header->trees.count; ++i) {
+        valid = (trees[i].nodeCount > 0 &&
+                 (uint64_t)trees[i].firstNode + trees[i].nodeCount <= header->nodes.count &&
+                 (kind == ModelArchiveKindIsolationForest ?
+                  ModelArchiveForestTreeIsValid(&trees[i], header, data.bytes, decoded) :
+                  ModelArchiveTreeIsValid(&trees[i], header, data.bytes, decoded)));
+    }
+    if (!valid) {
+        if (error)
+            *error = ModelArchiveErrorWithCode(ModelArchiveErrorInvalidFormat, @"Corrupted model archive");
+        return nil;
+    }
+
+    if (metadata)
+        *metadata = decoded;
+    return data;
+}
+
++ (NSArray*)predicatesWithArchivedPredicates:(NSArray*)archivedPredicates
+                                    resource:(FieldResource*)resource {
+
+    NSMutableArray* predicates = [NSMutableArray arrayWithCapacity:archivedPredicates.count];
+    for (NSDictionary* p in archivedPredicates) {
+        Predicate* predicate = [[Predicate alloc] initWithOperator:p[@"operator"]
+                                                             field:p[@"field"]
+                                                             value:p[@"value"]
+                                                              term:p[@"term"]];
+        [predicate prepareWithFields:resource.fields];
+        [predicate bindToSchema:resource.schema];
+        [predicates addObject:predicate];
+    }
+    return predicates;
+}
+
+- (instancetype)initWithContentsOfFile:(NSString*)path error:(NSError**)error {
+
+    NSDictionary* metadata = nil;
+    NSData* data = [ModelArchive mappedArchiveOfKind:ModelArchiveKindTrees
+                                              atPath:path
+                                            metadata:&metadata
+                                               error:error];
+    if (!data)
+        return nil;
+
+    const ModelArchiveHeader* header = data.bytes;
+    id objectiveFieldId = metadata[@"objective_field"];
+    if (self = [super initWithFields:metadata[@"fields"]
+                    objectiveFieldId:(objectiveFieldId == [NSNull null]) ? nil : objectiveFieldId
+                              locale:nil
+                       missingTokens:nil]) {
+
+        _data = data;
+        _treeCount = (NSUInteger)header->trees.count;
+        _trees = (const ModelArchiveTree*)((const char*)data.bytes + header->trees.offset);
+        _nodes = (const ModelArchiveNode*)((const char*)data.bytes + header->nodes.offset);
+        _entries = (const ModelArchiveEntry*)((const char*)data.bytes + header->entries.offset);
+        _categories = metadata[@"categories"];
+
+        //-- only the splits that are not numeric need a Predicate
+        _predicates = [ModelArchive predicatesWithArchivedPredicates:metadata[@"predicates"] resource:self];
+    }
+    return self;
+}
+
+#pragma mark - Predicting
+
+/**
+ * Walks a tree with the last prediction strategy, as CompiledTree does
+ */
+- (const ModelArchiveNode*)leafOfTree:(NSUInteger)treeIndex values:(const FieldValue*)values {
+
+    const ModelArchiveNode* nodes = _nodes + _trees[treeIndex].firstNode;
+    NSUInteger index = 0;
+
+    while (nodes[index].childCount > 0) {
+
+        const ModelArchiveNode* parent = &nodes[index];
+        NSUInteger lastChild = parent->firstChild + parent->childCount;
+        NSUInteger next = NSNotFound;
+
+        for (NSUInteger child = parent->firstChild; child < lastChild; ++child) {
+
+            const ModelArchiveNode* node = &nodes[child];
+            BOOL applies = NO;
+
+            if (node->numeric) {
+                applies = PredicateApplyNumericToValue(node->op, node->threshold, node->missing,
+                                                       &values[node->field]);
+            } else if (node->predicate != MODEL_ARCHIVE_NONE) {
+                applies = [(Predicate*)_predicates[node->predicate] applyToValues:values fields:self.fields];
+            }
+
+            if (applies) {
+                next = child;
+                break;
+            }
+        }
+        if (next == NSNotFound)
+            break;
+
+        index = next;
+    }
+    return &nodes[index];
+}
+
+- (double)roundedConfidence:(double)confidence {
+    return floor(confidence * 10000.0) / 10000.0;
+}
+
+/**
+ * Builds the same outputs as PredictiveModel's outputForPrediction:multiple:
+ */
+- (NSArray*)outputForNode:(const ModelArchiveNode*)node
+                   ofTree:(NSUInteger)treeIndex
+                 multiple:(NSUInteger)multiple {
+
+    BOOL isRegression = _trees[treeIndex].isRegression;
+    const ModelArchiveEntry* entries = _entries + node->firstEntry;
+
+    NSMutableDictionary* distribution = [NSMutableDictionary dictionaryWithCapacity:node->entryCount];
+    for (NSUInteger e = 0; e < node->entryCount; ++e) {
+        id value = isRegression ? @(entries[e].value) : _categories[(NSUInteger)entries[e].value];
+        [distribution setObject:@(entries[e].count) forKey:value];
+    }
+
+    NSMutableArray* output = [NSMutableArray new];
+    if (multiple != 0 && !isRegression) {
+        for (NSUInteger e = 0; e < MIN(node->entryCount, multiple); ++e) {
+            [output addObject:@{ @"prediction" : _categories[(NSUInteger)entries[e].value],
+                                 @"confidence" : @([self roundedConfidence:entries[e].confidence]),
+                                 @"probability" : @(entries[e].probability),
+                                 @"distribution" : distribution,
+                                 @"count" : @((long)entries[e].count) }];
+        }
+    } else {
+        id prediction = isRegression ? @(node->output) : _categories[(NSUInteger)node->output];
+        [output addObject:@{ @"prediction" : prediction,
+                             @"confidence" : @([self roundedConfidence:node->confidence]),
+                             @"distribution" : distribution,
+                             @"count" : @((long)node->count) }];
+    }
+    return output;
+}
+
+/**
+ * Whether the archive can honour the options: it keeps no PredictionTree,
+ * so it can neither apply the proportional missing strategy nor render a
+ * decision path
+ */
+- (BOOL)supportsOptions:(NSDictionary*)options {
+
+    return ([options[@"strategy"]?:@(MissingStrategyLastPrediction) intValue] == MissingStrategyLastPrediction &&
+            ![options[@"path"]?:@NO boolValue]);
+}
+
+- (NSArray*)predictWithArguments:(NSDictionary*)arguments
+                         options:(NSDictionary*)options {
+
+    return [self predictWithTree:0 arguments:arguments options:options];
+}
+
+- (NSArray*)predictWithTree:(NSUInteger)treeIndex
+                  arguments:(NSDictionary*)arguments
+                    options:(NSDictionary*)options {
+
+    BOOL byName = [options[@"byName"]?:@NO boolValue];
+    NSUInteger multiple = [options[@"multiple"]?:@0 intValue];
+
+    NSAssert(arguments, @"Prediction arguments missing.");
+    NSAssert(treeIndex < _treeCount, @"ModelArchive predictWithTree: tree index out of range");
+    if (![self supportsOptions:options])
+        return nil;
+
+    arguments = [ML4iOSUtils cast:[self filteredInputData:arguments byName:byName] fields:self.fields];
+
+    FieldValue* values = FieldValuesAlloc(self.schema.count);
+    [self.schema bindInput:arguments values:values];
+    const ModelArchiveNode* leaf = [self leafOfTree:treeIndex values:values];
+    free(values);
+    return [self outputForNode:leaf ofTree:treeIndex multiple:multiple];
+}
+
+- (NSDictionary*)combinedPredictionWithArguments:(NSDictionary*)arguments
+                                         options:(NSDictionary*)options {
+
+    ML4iOSPredictionMethod method = [options[@"method"] ?: @(ML4iOSPredictionMethodPlurality) intValue];
+    BOOL byName = [options[@"byName"] ?: @(NO) boolValue];
+    BOOL confidence = [options[@"confidence"] ?: @(YES) boolValue];
+    BOOL distribution = [options[@"distribution"] ?: @(NO) boolValue];
+    BOOL count = [options[@"count"] ?: @(NO) boolValue];
+    BOOL median = [options[@"median"] ?: @(NO) boolValue];
+    BOOL min = [options[@"min"] ?: @(NO) boolValue];
+    BOOL max = [options[@"max"] ?: @(NO) boolValue];
+
+    NSAssert(arguments, @"Prediction arguments missing.");
+    if (![self supportsOptions:options])
+        return nil;
+
+    //-- the input is read once and shared by all the trees
+    arguments = [ML4iOSUtils cast:[self filteredInputData:arguments byName:byName] fields:self.fields];
+    FieldValue* values = FieldValuesAlloc(self.schema.count);
+    [self.schema bindInput:arguments values:values];
+
+    MultiVote* votes = [MultiVote new];
+    for (NSUInteger tree = 0; tree < _treeCount; ++tree) {
+        [votes append:[self outputForNode:[self leafOfTree:tree values:values]
+                                   ofTree:tree
+                                 multiple:NSUIntegerMax].firstObject];
+    }
+    free(values);
+    if (median) {
+        [votes addMedian];
+    }
+    return [votes combineWithMethod:method
+                         confidence:confidence
+                       distribution:distribution
+                              count:count
+                             median:median
+                                min:min
+                                max:max
+                            options:options];
+}
+
+@end
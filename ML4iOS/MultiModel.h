@@ -18,14 +18,46 @@
 
 @interface MultiModel : NSObject
 
-- (instancetype)initWithModels:(NSArray*)ids;
+/**
+ * The PredictiveModel instances of the members
+ */
+@property (nonatomic, readonly) NSArray* models;
 
-+ (MultiModel*)multiModelWithModels:(NSArray*)ids;
+/**
+ * Builds the local models of a set of members once, so that they can
+ * be used for any number of predictions.
+ * @param models BigML models, or already built PredictiveModel instances
+ */
+- (instancetype)initWithModels:(NSArray*)models;
+
++ (MultiModel*)multiModelWithModels:(NSArray*)models;
 
 - (MultiVote*)generateVotes:(NSDictionary*)inputData
                      byName:(BOOL)byName
             missingStrategy:(NSInteger)missingStrategy
                      median:(BOOL)median;
 
+/**
+ * Same as generateVotes:byName:missingStrategy:median:, but the members are
+ * evaluated concurrently by at most `threads` workers (0 for one per active
+ * processor). Votes keep the members' order, so the result is the same.
+ */
+- (MultiVote*)generateVotes:(NSDictionary*)inputData
+                     byName:(BOOL)byName
+            missingStrategy:(NSInteger)missingStrategy
+                     median:(BOOL)median
+                    threads:(NSUInteger)threads;
+
+/**
+ * Same as generateVotes:byName:missingStrategy:median:, but the members are
+ * evaluated one at a time and evaluation stops as soon as `decided` returns
+ * YES. The block gets each new vote and the number of members left.
+ */
+- (MultiVote*)generateVotes:(NSDictionary*)inputData
+                     byName:(BOOL)byName
+            missingStrategy:(NSInteger)missingStrategy
+                     median:(BOOL)median
+                   stopWhen:(BOOL(^)(NSDictionary* vote, NSUInteger remaining))decided;
+
 @end
 
@@ -21,10 +21,21 @@
     NSArray* _models;
 }
 
+@synthesize models = _models;
+
 - (instancetype)initWithModels:(NSArray*)models {
     
     if (self = [super init]) {
-        _models = models;
+        
+        NSMutableArray* predictiveModels = [NSMutableArray arrayWithCapacity:models.count];
+        for (id model in models) {
+            if ([model isKindOfClass:[PredictiveModel class]]) {
+                [predictiveModels addObject:model];
+            } else {
+                [predictiveModels addObject:[[PredictiveModel alloc] initWithJSONModel:model]];
+            }
+        }
+        _models = predictiveModels;
     }
     return self;
 }
@@ -33,22 +44,92 @@
     return [[self alloc] initWithModels:models];
 }
 
+/**
+ * The options used to get the vote of each member
+ */
+- (NSDictionary*)voteOptionsByName:(BOOL)byName
+                   missingStrategy:(NSInteger)missingStrategy
+                            median:(BOOL)median {
+    
+    return @{ @"byName" : @(byName),
+              @"strategy" : @(missingStrategy),
+              @"median" : @(median),
+              @"confidence" : @(YES),
+              @"count" : @(YES),
+              @"distribution" : @(YES),
+              @"multiple" : @NSUIntegerMax };
+}
+
 - (MultiVote*)generateVotes:(NSDictionary*)inputData
                      byName:(BOOL)byName
             missingStrategy:(NSInteger)missingStrategy
                      median:(BOOL)median {
     
+    return [self generateVotes:inputData
+                        byName:byName
+               missingStrategy:missingStrategy
+                        median:median
+                       threads:1];
+}
+
+- (MultiVote*)generateVotes:(NSDictionary*)inputData
+                     byName:(BOOL)byName
+            missingStrategy:(NSInteger)missingStrategy
+                     median:(BOOL)median
+                    threads:(NSUInteger)threads {
+    
+    NSDictionary* options = [self voteOptionsByName:byName missingStrategy:missingStrategy median:median];
+    
+    NSArray* models = _models;
+    NSUInteger count = models.count;
+    NSUInteger workers = threads ?: [[NSProcessInfo processInfo] activeProcessorCount];
+    workers = MAX(MIN(workers, count), 1);
+    
+    //-- each worker fills its own buffer with a contiguous range of members,
+    //-- so that concatenating the buffers keeps the members' order
+    NSMutableArray* buffers = [NSMutableArray arrayWithCapacity:workers];
+    for (NSUInteger worker = 0; worker < workers; ++worker) {
+        [buffers addObject:[NSMutableArray arrayWithCapacity:count / workers + 1]];
+    }
+    void(^evaluate)(size_t) = ^(size_t worker) {
+        NSMutableArray* buffer = buffers[worker];
+        NSUInteger last = (worker + 1) * count / workers;
+        for (NSUInteger i = worker * count / workers; i < last; ++i) {
+            @autoreleasepool {
+                [buffer addObject:[models[i] predictWithArguments:inputData options:options].firstObject];
+            }
+        }
+    };
+    if (workers == 1) {
+        evaluate(0);
+    } else {
+        dispatch_apply(workers, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), evaluate);
+    }
+    
+    MultiVote* votes = [MultiVote new];
+    for (NSArray* buffer in buffers) {
+        for (NSDictionary* prediction in buffer) {
+            [votes append:prediction];
+        }
+    }
+    return votes;
+}
+
+- (MultiVote*)generateVotes:(NSDictionary*)inputData
+                     byName:(BOOL)byName
+            missingStrategy:(NSInteger)missingStrategy
+                     median:(BOOL)median
+                   stopWhen:(BOOL(^)(NSDictionary* vote, NSUInteger remaining))decided {
+    
+    NSDictionary* options = [self voteOptionsByName:byName missingStrategy:missingStrategy median:median];
+    
     MultiVote* votes = [MultiVote new];
-    for (NSDictionary* model in _models) {
-        [votes append:[PredictiveModel predictWithJSONModel:model
-                                                  arguments:inputData
-                                                    options:@{ @"byName" : @(byName),
-                                                               @"strategy" : @(missingStrategy),
-                                                               @"median" : @(median),
-                                                               @"confidence" : @(YES),
-                                                               @"count" : @(YES),
-                                                               @"distribution" : @(YES),
-                                                               @"multiple" : @NSUIntegerMax}]];
+    NSUInteger remaining = _models.count;
+    for (PredictiveModel* model in _models) {
+        NSDictionary* vote = [model predictWithArguments:inputData options:options].firstObject;
+        [votes append:vote];
+        if (decided(vote, --remaining))
+            break;
     }
     return votes;
 }
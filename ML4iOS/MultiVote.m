@@ -25,6 +25,34 @@ static NSString* const kNullCategory = @"kNullCategory";
 
 @end
 
+/**
+ * A vote as seen by the categorical combiners: its category interned to
+ * an integer id and its values unboxed.
+ */
+typedef struct MultiVoteEntry {
+    
+    NSUInteger category;
+    double weight;
+    double confidence;
+    NSInteger count;
+    NSInteger order;
+    BOOL hasConfidence;
+    
+} MultiVoteEntry;
+
+/**
+ * Returns the integer id of a category, interning it if needed
+ */
+static NSUInteger MultiVoteCategoryId(id category, NSMutableDictionary* categoryIds) {
+    
+    NSNumber* categoryId = categoryIds[category];
+    if (!categoryId) {
+        categoryId = @(categoryIds.count);
+        [categoryIds setObject:categoryId forKey:category];
+    }
+    return [categoryId unsignedIntegerValue];
+}
+
 /**
  * MultiVote: combiner class for ensembles voting predictions.
  *
@@ -377,201 +405,185 @@ static NSString* const kNullCategory = @"kNullCategory";
 }
 
 /**
- * Singles out the votes for a chosen category and returns a prediction
- *  for this category if the number of votes reaches at least the given
- *  threshold.
+ * Encodes the votes into entries, once, so that the combination runs over
+ * plain C arrays. For the probability method, each vote is expanded into
+ * one entry per category of its distribution, weighted by its probability.
+ * For the threshold method, only the votes for the chosen category are kept
+ * if there are at least threshold-k of them; the rest of the votes otherwise.
  *
- * @param threshold the number of the minimum positive predictions needed for
- *                    a final positive prediction.
- * @param category the positive category
- * @return MultiVote instance
+ * @return the number of entries
  */
-- (MultiVote*)singleOutCategory:(NSString*)category threshold:(NSInteger)threshold {
+- (NSUInteger)encodeEntries:(MultiVoteEntry*)entries
+                  forMethod:(ML4iOSPredictionMethod)method
+                  threshold:(NSInteger)threshold
+                   category:(NSString*)thresholdCategory
+                categoryIds:(NSMutableDictionary*)categoryIds
+                 categories:(NSMutableArray*)categories {
+    
+    NSString* weightLabel = [MultiVote combinationWeightsForMethod:method];
+    NSUInteger count = 0;
     
-    NSAssert(threshold > 0 && category.length > 0, @"MultiVote singleOutCategory contract unfulfilled");
-    NSAssert(threshold <= _predictions.count, @"MultiVote singleOutCategory: threshold higher than prediction count");
-    NSMutableArray* categoryPredictions = [NSMutableArray new];
-    NSMutableArray* restOfPredictions = [NSMutableArray new];
     for (NSDictionary* prediction in _predictions) {
-        if ([category isEqualToString:prediction[@"prediction"]]) {
-            [categoryPredictions addObject:prediction];
+        
+        NSInteger order = [prediction[@"order"] integerValue];
+        if (method == ML4iOSPredictionMethodProbability) {
+            
+            NSAssert(prediction[@"distribution"] && prediction[@"count"],
+                     @"Wrong prediction found: no distribution/count info");
+            long total = [prediction[@"count"] longValue];
+            NSAssert(total > 0, @"MultiVote encodeEntries: wrong total in distribution");
+            
+            NSDictionary* distribution = prediction[@"distribution"];
+            for (id key in distribution) {
+                int instances = [distribution[key] intValue];
+                entries[count++] = (MultiVoteEntry){ MultiVoteCategoryId(key, categoryIds),
+                    (double)instances / total, 0.0, instances, order, NO };
+            }
         } else {
-            [restOfPredictions addObject:prediction];
+            
+            id weight = nil;
+            if (weightLabel != kNullCategory) {
+                weight = prediction[weightLabel];
+                NSAssert(weight,
+                         @"MultiVote encodeEntries: Not enough data to use the selected prediction method.");
+            }
+            id confidence = prediction[@"confidence"];
+            entries[count++] = (MultiVoteEntry){ MultiVoteCategoryId(prediction[@"prediction"], categoryIds),
+                [weight doubleValue], [confidence doubleValue], [prediction[@"count"] intValue], order,
+                confidence != nil };
         }
     }
-    if (categoryPredictions.count >= threshold) {
-        return [[MultiVote alloc] initWithPredictions:categoryPredictions];
-    } else {
-        return [[MultiVote alloc] initWithPredictions:restOfPredictions];
-    }
-}
-
-/**
- * Compute the combined weighted confidence from a list of predictions
- *
- * @param combinedPrediction {object} combinedPrediction Prediction object
- * @param weightLabel {string} weightLabel Label of the value in the prediction object
- *        that will be used to weight confidence
- */
-- (NSDictionary*)weightedConfidence:(id)combinedPrediction weightLabel:(id)weightLabel {
     
-    double finalConfidence = 0.0;
-    double weight = 1.0;
-    double totalWeight = 0.0;
-    NSMutableArray* predictionList = [NSMutableArray new];
-    
-    for (NSDictionary* prediction in _predictions) {
-        if ([prediction[@"prediction"] isEqual:combinedPrediction]) {
-            [predictionList addObject:prediction];
+    if (method == ML4iOSPredictionMethodThreshold) {
+        
+        NSAssert(threshold > 0 && thresholdCategory.length > 0,
+                 @"MultiVote threshold method contract unfulfilled");
+        NSAssert(threshold <= count, @"MultiVote threshold method: threshold higher than prediction count");
+        NSNumber* categoryId = categoryIds[thresholdCategory];
+        NSUInteger category = categoryId ? [categoryId unsignedIntegerValue] : NSNotFound;
+        
+        NSInteger categoryVotes = 0;
+        for (NSUInteger i = 0; i < count; ++i) {
+            categoryVotes += (entries[i].category == category);
         }
-    }
-    if (weightLabel && weightLabel != kNullCategory) {
-        for (NSDictionary* prediction in _predictions) {
-            NSAssert(prediction[@"confidence"] && prediction[weightLabel],
-                     @"MultiVote weightedConfidence: not enough data to use selected method (missing %@)",
-                     weightLabel);
+        BOOL keepCategory = (categoryVotes >= threshold);
+        NSUInteger kept = 0;
+        for (NSUInteger i = 0; i < count; ++i) {
+            if ((entries[i].category == category) == keepCategory) {
+                entries[kept++] = entries[i];
+            }
         }
+        count = kept;
     }
     
-    for (NSDictionary* prediction in _predictions) {
-        if (weightLabel && weightLabel != kNullCategory) {
-            weight = [prediction[@"confidence"] doubleValue];
-        }
-        finalConfidence += weight * [prediction[@"confidence"] doubleValue];
-        totalWeight += weight;
+    //-- categories by id, to produce the result
+    [categories removeAllObjects];
+    for (NSUInteger i = 0; i < categoryIds.count; ++i) {
+        [categories addObject:[NSNull null]];
     }
-    
-    if (totalWeight > 0) {
-        finalConfidence = finalConfidence / totalWeight;
-    } else {
-        finalConfidence = 0.0;
+    for (id category in categoryIds) {
+        categories[[categoryIds[category] unsignedIntegerValue]] = category;
     }
-    
-    NSMutableDictionary* result = [NSMutableDictionary new];
-    [result setObject:combinedPrediction forKey:@"prediction"];
-    [result setObject:@(finalConfidence) forKey:@"confidence"];
-    
-    return result;
+    return count;
 }
 
 /**
- * Builds a distribution based on the predictions of the MultiVote
+ * Returns the combined prediction of the votes: the category with the
+ * highest total weight (the earliest one in case of a tie) and, if asked for,
+ * its combined confidence.
  *
- * @param weightLabel {string} weightLabel Label of the value in the prediction object
- *        whose sum will be used as count in the distribution
+ * The confidence is the average of the votes' confidences, weighted by
+ * themselves for weighted methods. When votes have no confidence, the
+ * Wilson score of the category in the distribution of weights is used.
  */
-- (NSArray*)combineDistribution:(NSString*)weightLabel {
-    
-    NSInteger total = 0;
-    NSMutableDictionary* distribution = [NSMutableDictionary new];
+- (NSDictionary*)combineCategoricalWithMethod:(ML4iOSPredictionMethod)method
+                                   confidence:(BOOL)confidence
+                                      options:(NSDictionary*)options {
     
-    if (weightLabel.length == 0) {
-        weightLabel = [MultiVote weightLabels][ML4iOSPredictionMethodProbability];
-    }
+    BOOL weighted = ([MultiVote combinationWeightsForMethod:method] != kNullCategory);
+    NSUInteger capacity = 0;
     for (NSDictionary* prediction in _predictions) {
-        NSAssert(prediction[weightLabel], @"MultiVote combineDistribution contract unfulfilled");
-        
-        NSString* predictionName = prediction[@"prediction"];
-        if (!distribution[predictionName]) {
-            [distribution setObject:@(0.0) forKey:predictionName];
+        capacity += (method == ML4iOSPredictionMethodProbability) ? [prediction[@"distribution"] count] : 1;
+    }
+    capacity = MAX(capacity, 1);
+    
+    //-- a single block holds the entries and the per category totals
+    void* block = malloc(capacity * (sizeof(MultiVoteEntry) + sizeof(double) + sizeof(NSInteger)));
+    MultiVoteEntry* entries = block;
+    double* categoryWeights = (double*)(entries + capacity);
+    NSInteger* categoryOrders = (NSInteger*)(categoryWeights + capacity);
+    
+    NSMutableDictionary* categoryIds = [NSMutableDictionary new];
+    NSMutableArray* categories = [NSMutableArray new];
+    NSUInteger count = [self encodeEntries:entries
+                                 forMethod:method
+                                 threshold:[options[@"threshold-k"] intValue]
+                                  category:options[@"threshold-category"]
+                               categoryIds:categoryIds
+                                categories:categories];
+    NSUInteger categoryCount = categories.count;
+    
+    for (NSUInteger c = 0; c < categoryCount; ++c) {
+        categoryWeights[c] = 0.0;
+        categoryOrders[c] = NSIntegerMin;
+    }
+    for (NSUInteger i = 0; i < count; ++i) {
+        const MultiVoteEntry* entry = &entries[i];
+        categoryWeights[entry->category] += weighted ? entry->weight : 1.0;
+        if (categoryOrders[entry->category] == NSIntegerMin) {
+            categoryOrders[entry->category] = entry->order;
         }
-        [distribution setObject:@([distribution[predictionName] doubleValue] + [prediction[weightLabel] doubleValue])
-                        forKey:predictionName];
-        total += [prediction[@"count"] intValue];
     }
-    return @[distribution, @(total)];
     
-}
-
-- (NSDictionary*)combineCategorical:(NSString*)weightLabel confidence:(BOOL)confidence {
-    
-    double weight = 1.0;
-    id category;
-    NSMutableDictionary* mode = [NSMutableDictionary new];
-    NSMutableArray* tuples = [NSMutableArray new];
-    
-    for (NSDictionary* prediction in _predictions) {
-        if (weightLabel != kNullCategory) {
-            NSAssert([[MultiVote weightLabels] indexOfObject:weightLabel] != NSNotFound,
-                     @"MultiVote combineCategorical: wrong weightLabel");
-            NSAssert(prediction[weightLabel],
-                     @"MultiVote combineCategorical: Not enough data to use the selected prediction method.");
-            if (prediction[weightLabel])
-                weight = [prediction[weightLabel] doubleValue];
-        }
-        category = prediction[@"prediction"];
-        
-        NSMutableDictionary* categoryHash = [NSMutableDictionary new];
-        if (mode[category]) {
-            [categoryHash setObject:@([mode[category][@"count"] doubleValue] + weight) forKey:@"count"];
-            [categoryHash setObject:mode[category][@"order"] forKey:@"order"];
-        } else {
-            [categoryHash setObject:@(weight) forKey:@"count"];
-            [categoryHash setObject:prediction[@"order"] forKey:@"order"];
-        }
-        [mode setObject:categoryHash forKey:category];
-    }
-    for (id key in mode.allKeys) {
-        if (mode[key]) {
-            NSArray* tuple = @[key, mode[key]];
-            [tuples addObject:tuple];
+    NSUInteger winner = NSNotFound;
+    for (NSUInteger c = 0; c < categoryCount; ++c) {
+        if (categoryOrders[c] == NSIntegerMin)
+            continue;
+        if (winner == NSNotFound ||
+            categoryWeights[c] > categoryWeights[winner] ||
+            (categoryWeights[c] == categoryWeights[winner] && categoryOrders[c] < categoryOrders[winner])) {
+            winner = c;
         }
     }
-    NSArray* tuple =
-    [tuples sortedArrayUsingComparator:^NSComparisonResult(NSArray*  _Nonnull obj1,
-                                                           NSArray*  _Nonnull obj2) {
-        
-        NSDictionary* d1 = obj1[1];
-        NSDictionary* d2 = obj2[1];
-        double w1 = [d1[@"count"] doubleValue];
-        double w2 = [d2[@"count"] doubleValue];
-        int order1 = [d1[@"order"] intValue];
-        int order2 = [d2[@"order"] intValue];
-        return w1 > w2 ? -1 : (w1 < w2 ? 1 : order1 < order2 ? -1 : 1);
-    }].firstObject;
-    id predictionName = tuple.firstObject;
     
     NSMutableDictionary* result = [NSMutableDictionary new];
-    [result setObject:predictionName forKey:@"prediction"];
-    
-    if (confidence) {
-        if ([_predictions.firstObject valueForKey:@"confidence"]) {
-            return [self weightedConfidence:predictionName weightLabel:weightLabel];
-        }
-        
-        NSArray* distributionInfo = [self combineDistribution:weightLabel];
-        NSInteger count = [distributionInfo[1] intValue];
-        NSDictionary* distribution = distributionInfo[0];
-        double combinedConfidence = [ML4iOSUtils wsConfidence:predictionName
-                                                 distribution:distribution
-                                                        count:count];
-        [result setObject:@(combinedConfidence) forKey:@"confidence"];
+    if (winner != NSNotFound) {
+        [result setObject:categories[winner] forKey:@"prediction"];
     }
-    return result;
-}
-
-- (NSArray*)probabilityWeight {
     
-    NSMutableArray* predictions = [NSMutableArray new];
-    
-    for (NSDictionary* prediction in _predictions) {
-     
-        NSAssert(prediction[@"distribution"] && prediction[@"count"],
-                 @"Wrong prediction found: no distribution/count info");
-        long total = [prediction[@"count"] longValue];
-        NSAssert(total > 0, @"Wrong total in probabilityWeight");
+    if (confidence && winner != NSNotFound) {
         
-        NSMutableDictionary* distribution = prediction[@"distribution"];
-        for (NSString* key in distribution.allKeys) {
-            int instances = [distribution[key] intValue];
-            [predictions addObject:@{ @"prediction" : key,
-                                      @"probability" : @((double)instances / total),
-                                      @"count" : @(instances),
-                                      @"order" : prediction[@"order"]
-                                     }];
+        double combinedConfidence = 0.0;
+        if (entries[0].hasConfidence) {
+            
+            double totalWeight = 0.0;
+            for (NSUInteger i = 0; i < count; ++i) {
+                double weight = weighted ? entries[i].confidence : 1.0;
+                combinedConfidence += weight * entries[i].confidence;
+                totalWeight += weight;
+            }
+            combinedConfidence = (totalWeight > 0) ? combinedConfidence / totalWeight : 0.0;
+            
+        } else {
+            
+            double norm = 0.0;
+            NSInteger instances = 0;
+            for (NSUInteger c = 0; c < categoryCount; ++c) {
+                norm += weighted ? categoryWeights[c] : 0.0;
+            }
+            for (NSUInteger i = 0; i < count; ++i) {
+                instances += entries[i].count;
+            }
+            combinedConfidence = ML4iOSWilsonScore(weighted ? categoryWeights[winner] : 0.0,
+                                                   norm,
+                                                   instances,
+                                                   ML4iOSWilsonScoreDefaultZ);
         }
+        [result setObject:@(combinedConfidence) forKey:@"confidence"];
     }
-    return predictions;
+    free(block);
+    
+    return result;
 }
 
 /**
@@ -621,19 +633,9 @@ static NSString* const kNullCategory = @"kNullCategory";
                                        max:(BOOL)max];
     }
     
-    MultiVote* votes = nil;
-    if (method == ML4iOSPredictionMethodThreshold) {
-        NSInteger threshold = [options[@"threshold-k"] intValue];
-        NSString* category = options[@"threshold-category"];
-        votes = [self singleOutCategory:category threshold:threshold];
-    } else if (method == ML4iOSPredictionMethodProbability) {
-        votes = [[MultiVote alloc] initWithPredictions:[self probabilityWeight]];
-    } else {
-        votes = self;
-    }
-    
-    return [votes combineCategorical:[MultiVote combinationWeightsForMethod:method]
-                          confidence:confidence];
+    return [self combineCategoricalWithMethod:method
+                                   confidence:confidence
+                                      options:options];
 }
 
 /**
@@ -13,6 +13,7 @@
 // under the License.
 
 #import <Foundation/Foundation.h>
+#import "FieldSchema.h"
 
 typedef enum PredicateLanguage {
     
@@ -20,11 +21,96 @@ typedef enum PredicateLanguage {
     
 } PredicateLanguage;
 
+/**
+ * Operators a Predicate can hold, decoded once from the BigML operator string
+ */
+typedef enum PredicateOperator {
+    
+    PredicateOperatorTrue,
+    PredicateOperatorLessThan,
+    PredicateOperatorLessOrEqual,
+    PredicateOperatorEqual,
+    PredicateOperatorNotEqual,
+    PredicateOperatorGreaterOrEqual,
+    PredicateOperatorGreaterThan,
+    PredicateOperatorIn,
+    PredicateOperatorUnknown
+    
+} PredicateOperator;
+
+/**
+ * Compares two numbers with the given operator
+ */
+static inline BOOL PredicateCompareNumbers(PredicateOperator op, double lhs, double rhs) {
+    
+    switch (op) {
+        case PredicateOperatorLessThan:
+            return lhs < rhs;
+        case PredicateOperatorLessOrEqual:
+            return lhs <= rhs;
+        case PredicateOperatorEqual:
+            return lhs == rhs;
+        case PredicateOperatorNotEqual:
+            return lhs != rhs;
+        case PredicateOperatorGreaterOrEqual:
+            return lhs >= rhs;
+        case PredicateOperatorGreaterThan:
+            return lhs > rhs;
+        default:
+            return NO;
+    }
+}
+
+/**
+ * Applies a numeric split to a bound input value the same way Predicate
+ * does: missing values follow the split's missing flag, and values that
+ * are not numbers are compared through their doubleValue, if any.
+ */
+static inline BOOL PredicateApplyNumericToValue(PredicateOperator op,
+                                                double threshold,
+                                                BOOL missing,
+                                                const FieldValue* value) {
+    
+    if (value->isNumber)
+        return PredicateCompareNumbers(op, value->number, threshold);
+    if (!value->object)
+        return missing;
+    if (![value->object respondsToSelector:@selector(doubleValue)])
+        return NO;
+    return PredicateCompareNumbers(op, [value->object doubleValue], threshold);
+}
+
 @interface RegExHelper : NSObject
 
 + (NSString*)firstRegexMatch:(NSString*)regex in:(NSString*)string;
 + (BOOL)isRegex:(NSString*)regex matching:(NSString*)string;
 
+/**
+ * Returns a compiled regular expression. Expressions are cached by pattern,
+ * so they are only compiled the first time they are used.
+ */
++ (NSRegularExpression*)regularExpressionWithPattern:(NSString*)pattern
+                                             options:(NSRegularExpressionOptions)options
+                                               error:(NSError**)error;
+
+@end
+
+
+/**
+ * Counts the occurrences of a term, or any of its forms, in the value of
+ * a text field according to the field's term_analysis options
+ * (token_mode, case_sensitive).
+ */
+@interface TermMatcher : NSObject
+
+@property (nonatomic, readonly) BOOL isFullTerm;
+
+- (instancetype)initWithTerm:(NSString*)term
+                       forms:(NSArray*)forms
+                     options:(NSDictionary*)options;
+
+- (NSUInteger)countIn:(NSString*)text;
+
 @end
 
 
@@ -37,13 +123,35 @@ typedef enum PredicateLanguage {
 @property (nonatomic, strong) NSString* field;
 @property (nonatomic, strong) NSString* value;
 @property (nonatomic) BOOL missing;
+@property (nonatomic, readonly) PredicateOperator operatorCode;
+@property (nonatomic, readonly) NSString* term;
+@property (nonatomic, readonly) NSUInteger fieldIndex;
 
 - (instancetype)initWithOperator:(NSString*)op
                            field:(NSString*)field
                            value:(id)value
                             term:(NSString*)term;
 
+/**
+ * Builds the term matcher of text predicates from the model fields.
+ * Should be called once, when the model is loaded.
+ */
+- (void)prepareWithFields:(NSDictionary*)fields;
+
+/**
+ * Resolves the predicate's field to its index in the given schema, so that
+ * it can be applied to bound input values.
+ */
+- (void)bindToSchema:(FieldSchema*)schema;
+
 - (BOOL)apply:(NSDictionary*)input fields:(NSDictionary*)fields;
+
+/**
+ * Same as apply:fields:, for an input bound by the schema given to
+ * bindToSchema:
+ */
+- (BOOL)applyToValues:(const FieldValue*)values fields:(NSDictionary*)fields;
+
 - (NSString*)ruleWithFields:(NSDictionary*)fields label:(NSString*)label;
 
 @end
@@ -52,7 +160,10 @@ typedef enum PredicateLanguage {
 @interface Predicates : NSObject
 
 - (instancetype)initWithPredicates:(NSArray*)predicates;
+- (void)prepareWithFields:(NSDictionary*)fields;
+- (void)bindToSchema:(FieldSchema*)schema;
 - (BOOL)apply:(NSDictionary*)input fields:(NSDictionary*)fields;
+- (BOOL)applyToValues:(const FieldValue*)values fields:(NSDictionary*)fields;
 - (NSString*)ruleWithFields:(NSDictionary*)fields label:(NSString*)label;
 
 @end
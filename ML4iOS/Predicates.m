@@ -13,6 +13,7 @@
 // under the License.
 
 #import "Predicates.h"
+#import "Constants.h"
 
 NSString* plural(NSString* string, int multiplicity) {
     
@@ -24,14 +25,33 @@ NSString* plural(NSString* string, int multiplicity) {
 
 @implementation RegExHelper
 
++ (NSRegularExpression*)regularExpressionWithPattern:(NSString*)pattern
+                                             options:(NSRegularExpressionOptions)options
+                                               error:(NSError**)error {
+    
+    static NSCache* cache = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        cache = [NSCache new];
+    });
+    
+    NSString* key = [NSString stringWithFormat:@"%lu:%@", (unsigned long)options, pattern];
+    NSRegularExpression* r = [cache objectForKey:key];
+    if (!r) {
+        r = [NSRegularExpression regularExpressionWithPattern:pattern options:options error:error];
+        if (r)
+            [cache setObject:r forKey:key];
+    }
+    return r;
+}
+
 + (NSString*)firstRegexMatch:(NSString*)regex in:(NSString*)string {
     
     NSString* result = nil;
     NSError* error = nil;
-    NSRegularExpression* r = [NSRegularExpression
-                              regularExpressionWithPattern:regex
-                              options:0
-                              error:&error];
+    NSRegularExpression* r = [self regularExpressionWithPattern:regex
+                                                        options:0
+                                                          error:&error];
     NSAssert(!error, @"Error in regex: %@", [error localizedDescription]);
     if (!error) {
         NSRange range = [r rangeOfFirstMatchInString:string
@@ -60,12 +80,133 @@ NSString* plural(NSString* string, int multiplicity) {
 #define TM_ALL @"all"
 #define FULL_TERM_PATTERN @"^.+\\b.+$"
 
+@implementation TermMatcher {
+    
+    NSString* _fullTerm;
+    NSSet* _forms;
+    NSUInteger _minLength;
+    NSUInteger _maxLength;
+    NSRegularExpression* _formsRegex;
+    BOOL _caseSensitive;
+}
+
+- (instancetype)initWithTerm:(NSString*)term
+                       forms:(NSArray*)forms
+                     options:(NSDictionary*)options {
+    
+    if (self = [super init]) {
+        
+        NSString* tokenMode = TM_TOKENS;
+        _caseSensitive = YES;
+        if ([options[@"token_mode"] isKindOfClass:[NSString class]]) {
+            tokenMode = options[@"token_mode"];
+        }
+        if ([options[@"case_sensitive"] respondsToSelector:@selector(boolValue)]) {
+            _caseSensitive = [options[@"case_sensitive"] boolValue];
+        }
+        
+        NSArray* allForms = [@[term] arrayByAddingObjectsFromArray:forms ?: @[]];
+        _isFullTerm = ([tokenMode isEqualToString:TM_FULL_TERMS] ||
+                       ([tokenMode isEqualToString:TM_ALL] &&
+                        [RegExHelper isRegex:FULL_TERM_PATTERN matching:term]));
+        
+        if ([tokenMode isEqualToString:TM_FULL_TERMS] ||
+            (_isFullTerm && allForms.count == 1)) {
+            _fullTerm = term;
+        } else {
+            [self prepareTokenForms:allForms];
+        }
+    }
+    return self;
+}
+
+/**
+ * Single-word forms are matched by splitting the text into tokens and
+ * looking them up in a set. Forms that span several tokens fall back to
+ * a regular expression that is compiled here, once.
+ */
+- (void)prepareTokenForms:(NSArray*)forms {
+    
+    NSCharacterSet* separators = [[NSCharacterSet alphanumericCharacterSet] invertedSet];
+    NSMutableSet* tokenForms = [NSMutableSet setWithCapacity:forms.count];
+    NSMutableArray* patterns = [NSMutableArray arrayWithCapacity:forms.count];
+    BOOL needsRegex = NO;
+    
+    _minLength = NSUIntegerMax;
+    _maxLength = 0;
+    for (NSString* form in forms) {
+        if ([form rangeOfCharacterFromSet:separators].location != NSNotFound) {
+            needsRegex = YES;
+        }
+        [tokenForms addObject:_caseSensitive ? form : [form lowercaseString]];
+        [patterns addObject:[NSRegularExpression escapedPatternForString:form]];
+        _minLength = MIN(_minLength, form.length);
+        _maxLength = MAX(_maxLength, form.length);
+    }
+    if (needsRegex) {
+        NSString* pattern = [NSString stringWithFormat:@"(\\b|_)(%@)(\\b|_)",
+                             [patterns componentsJoinedByString:@"|"]];
+        _formsRegex = [RegExHelper regularExpressionWithPattern:pattern
+                                                        options:(_caseSensitive ? 0 :
+                                                                 NSRegularExpressionCaseInsensitive)
+                                                          error:nil];
+    }
+    _forms = tokenForms;
+}
+
+- (NSUInteger)countIn:(NSString*)text {
+    
+    if (_fullTerm) {
+        if (_caseSensitive)
+            return [text isEqualToString:_fullTerm] ? 1 : 0;
+        return [text caseInsensitiveCompare:_fullTerm] == NSOrderedSame ? 1 : 0;
+    }
+    if (_formsRegex) {
+        return [_formsRegex numberOfMatchesInString:text
+                                            options:0
+                                              range:NSMakeRange(0, text.length)];
+    }
+    
+    static NSCharacterSet* separators = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        separators = [[NSCharacterSet alphanumericCharacterSet] invertedSet];
+    });
+    
+    NSUInteger count = 0;
+    NSUInteger length = text.length;
+    NSUInteger start = 0;
+    while (start < length) {
+        NSRange separator = [text rangeOfCharacterFromSet:separators
+                                                  options:0
+                                                    range:NSMakeRange(start, length - start)];
+        NSUInteger end = (separator.location == NSNotFound) ? length : separator.location;
+        NSUInteger tokenLength = end - start;
+        if (tokenLength >= _minLength && tokenLength <= _maxLength) {
+            NSString* token = [text substringWithRange:NSMakeRange(start, tokenLength)];
+            if ([_forms containsObject:(_caseSensitive ? token : [token lowercaseString])]) {
+                ++count;
+            }
+        }
+        start = end + 1;
+    }
+    return count;
+}
+
+@end
+
+
 @implementation Predicate {
 
     NSString* _op;
     NSString* _field;
     id _value;
     NSString* _term;
+    
+    BOOL _valueIsNumber;
+    double _numericValue;
+    NSSet* _valueSet;
+    TermMatcher* _termMatcher;
 }
 
 - (instancetype)initWithOperator:(NSString*)op
@@ -79,22 +220,87 @@ NSString* plural(NSString* string, int multiplicity) {
         _value = value;
         _term = term;
         _missing = NO;
-        if ([RegExHelper isRegex:@"\\*$" matching:_op]) {
+        _fieldIndex = NSNotFound;
+        if ([_op hasSuffix:@"*"]) {
             _missing = YES;
             _op = [_op substringToIndex:_op.length - 1];
         }
         if ([_op length] == 0)
             NSLog(@"CONY");
-
+        _operatorCode = [self operatorCodeForOperator:_op];
+        
+        //-- unbox the value once, so that apply:fields: can compare directly
+        _valueIsNumber = [_value isKindOfClass:[NSNumber class]];
+        _numericValue = _valueIsNumber ? [_value doubleValue] : NAN;
+        if (_operatorCode == PredicateOperatorIn) {
+            if ([_value isKindOfClass:[NSArray class]]) {
+                _valueSet = [NSSet setWithArray:_value];
+            } else if (_value) {
+                _valueSet = [NSSet setWithObject:_value];
+            }
+        }
     }
     return self;
 }
 
+- (PredicateOperator)operatorCodeForOperator:(NSString*)op {
+    
+    static NSDictionary* operatorCodes = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        operatorCodes = @{ @"TRUE" : @(PredicateOperatorTrue),
+                           OPERATOR_LT : @(PredicateOperatorLessThan),
+                           OPERATOR_LE : @(PredicateOperatorLessOrEqual),
+                           OPERATOR_EQ : @(PredicateOperatorEqual),
+                           OPERATOR_NE : @(PredicateOperatorNotEqual),
+                           OPERATOR_NE2 : @(PredicateOperatorNotEqual),
+                           OPERATOR_GE : @(PredicateOperatorGreaterOrEqual),
+                           OPERATOR_GT : @(PredicateOperatorGreaterThan),
+                           @"in" : @(PredicateOperatorIn) };
+    });
+    NSNumber* code = op ? operatorCodes[op] : nil;
+    return code ? [code intValue] : PredicateOperatorUnknown;
+}
+
+/**
+ * Builds the matcher used to count the occurrences of the predicate's term
+ * in a text field
+ */
+- (TermMatcher*)termMatcherWithFields:(NSDictionary*)fields {
+    
+    NSDictionary* field = fields[_field];
+    NSArray* termForms = nil;
+    if ([field[@"summary"] isKindOfClass:[NSDictionary class]] &&
+        [field[@"summary"][@"term_forms"] isKindOfClass:[NSDictionary class]] &&
+        [field[@"summary"][@"term_forms"][_term] isKindOfClass:[NSArray class]]) {
+        
+        termForms = field[@"summary"][@"term_forms"][_term];
+    }
+    NSDictionary* options = [field[@"term_analysis"] isKindOfClass:[NSDictionary class]] ?
+    field[@"term_analysis"] : nil;
+    
+    return [[TermMatcher alloc] initWithTerm:_term forms:termForms options:options];
+}
+
+- (void)prepareWithFields:(NSDictionary*)fields {
+    
+    if (_term) {
+        _termMatcher = [self termMatcherWithFields:fields];
+    }
+}
+
+- (void)bindToSchema:(FieldSchema*)schema {
+    _fieldIndex = [schema indexOfFieldId:_field];
+}
+
 /**
  * Returns a boolean showing if a term is considered as a full_term
  */
 - (BOOL)isFullTermWithFields:(NSDictionary*)fields {
     
+    if (_termMatcher)
+        return _termMatcher.isFullTerm;
+    
     if (_term && fields[self.field][@"term_analysis"]) {
     
         NSAssert([fields[self.field] isKindOfClass:[NSDictionary class]], @"Bad fields");
@@ -102,12 +308,7 @@ NSString* plural(NSString* string, int multiplicity) {
                  [fields[self.field][@"term_analysis"] isKindOfClass:[NSDictionary class]],
                  @"Bad term_analysis");
 
-        if ([fields[self.field][@"term_analysis"][@"token_mode"] isEqualToString:TM_FULL_TERMS]) {
-            return YES;
-        }
-        if ([fields[self.field][@"term_analysis"][@"token_mode"] isEqualToString:TM_ALL]) {
-            return [RegExHelper isRegex:FULL_TERM_PATTERN matching:_term];
-        }
+        return [self termMatcherWithFields:fields].isFullTerm;
     }
     return NO;
 }
@@ -161,92 +362,82 @@ NSString* plural(NSString* string, int multiplicity) {
     return  _op;
 }
 
-- (NSInteger)fullTermCount:(NSString*)text
-                  fullTerm:(NSString*)fullTerm
-             caseSensitive:(BOOL)caseSensitive {
+/**
+ * Compares an input value against the predicate value
+ */
+- (BOOL)compareValue:(id)inputValue {
     
-    return (caseSensitive ?
-            ((text == fullTerm) ? 1 : 0) :
-            ([RegExHelper isRegex:@"/^\(fullTerm)$/i" matching:text] ? 1 : 0));
-}
-
-- (NSInteger)tokenTermCount:(NSString*)text
-                   forms:(NSArray*)forms
-              caseSensitive:(BOOL)caseSensitive {
-
-    NSString* fre = [forms componentsJoinedByString:@"(\\b|_)"];
-    NSString* re = [NSString stringWithFormat:@"(\\b|_)%@(\\b|_)", fre];
-    return [RegExHelper countOfMatches:re in:text];
-}
-
-- (NSInteger)termCount:(NSString*)text forms:(NSArray*)forms options:(NSDictionary*)options {
+    if (!_value)
+        return NO;
     
-    NSString* tokenMode = TM_TOKENS;
-    BOOL caseSensitive = YES;
-    if (options && [options[@"token_mode"] isKindOfClass:[NSString class]]) {
-        tokenMode = options[@"token_mode"];
-    }
-    if (options && [options[@"case_sensitive"] respondsToSelector:@selector(boolValue)]) {
-        caseSensitive = [options[@"case_sensitive"] boolValue];
+    if (_valueIsNumber) {
+        if (![inputValue respondsToSelector:@selector(doubleValue)])
+            return NO;
+        return PredicateCompareNumbers(_operatorCode, [inputValue doubleValue], _numericValue);
     }
-    NSString* firstTerm = forms.firstObject;
-    if ([tokenMode isEqualToString:TM_FULL_TERMS] ||
-        ([tokenMode isEqualToString:TM_ALL] &&
-         forms.count == 1 &&
-         [RegExHelper isRegex:FULL_TERM_PATTERN matching:firstTerm])) {
-            
-        return [self fullTermCount:text fullTerm:firstTerm caseSensitive:caseSensitive];
+    
+    switch (_operatorCode) {
+        case PredicateOperatorEqual:
+            return [inputValue isEqual:_value];
+        case PredicateOperatorNotEqual:
+            return ![inputValue isEqual:_value];
+        default:
+            break;
     }
-    return [self tokenTermCount:text forms:forms caseSensitive:caseSensitive];
+    if (![inputValue isKindOfClass:[_value class]] ||
+        ![inputValue respondsToSelector:@selector(compare:)])
+        return NO;
+    
+    //-- ordering comparisons on non numeric values
+    NSComparisonResult result = [inputValue compare:_value];
+    return PredicateCompareNumbers(_operatorCode, result, NSOrderedSame);
 }
 
-- (BOOL)evalPredicate:(NSString*)predicate args:(NSDictionary*)args {
+/**
+ * Applies the predicate to the value of its field, or nil if missing
+ */
+- (BOOL)applyToInputValue:(id)inputValue fields:(NSDictionary*)fields {
     
-    if ([predicate isEqualToString:@"ls  rs"])
-        NSLog(@"CONY");
-    NSPredicate* p = [NSPredicate predicateWithFormat:predicate];
-    return [p evaluateWithObject:args];
+    if (!inputValue) {
+        return _missing || (_operatorCode == PredicateOperatorEqual && !_value);
+    } else if (_operatorCode == PredicateOperatorNotEqual && !_value) {
+        return YES;
+    }
+    
+    if (_operatorCode == PredicateOperatorIn) {
+        return [_valueSet containsObject:inputValue];
+    }
+    if (_term && [inputValue isKindOfClass:[NSString class]]) {
+        
+        TermMatcher* termMatcher = _termMatcher ?: [self termMatcherWithFields:fields];
+        if (!_valueIsNumber)
+            return NO;
+        return PredicateCompareNumbers(_operatorCode, [termMatcher countIn:inputValue], _numericValue);
+    }
+    return [self compareValue:inputValue];
 }
 
 - (BOOL)apply:(NSDictionary*)input fields:(NSDictionary*)fields {
     
-    if ([_op isEqualToString:@"TRUE"])
+    if (_operatorCode == PredicateOperatorTrue)
         return YES;
     
-    if (!input[_field]) {
-        return _missing || ([_op isEqualToString:@"="] && !_value);
-    } else if ([_op isEqualToString:@"!="] && !_value) {
+    return [self applyToInputValue:input[_field] fields:fields];
+}
+
+- (BOOL)applyToValues:(const FieldValue*)values fields:(NSDictionary*)fields {
+    
+    if (_operatorCode == PredicateOperatorTrue)
         return YES;
-    }
+    if (_fieldIndex == NSNotFound)
+        return [self applyToInputValue:nil fields:fields];
     
-    if ([_op isEqualToString:@"in"]) {
-        return [self evalPredicate:[NSString stringWithFormat:@"ls %@ rs", _op]
-                              args:@{ @"ls" : input[_field], @"rs" : _value ?: [NSNull null]}];
-    }
-    if (_term &&
-        [input[_field] isKindOfClass:[NSString class]] &&
-        [fields[_field] isKindOfClass:[NSString class]]) {
-        
-        NSArray* termForms = [NSArray new];
-        if ([fields[@"summary"] isKindOfClass:[NSDictionary class]] &&
-            [fields[@"summary"][@"term_forms"] isKindOfClass:[NSDictionary class]] &&
-            [fields[@"summary"][@"term_forms"][_term] isKindOfClass:[NSArray class]]) {
-            
-            termForms = fields[@"summary"][@"term_forms"][_term];
-        }
-        NSArray* terms = [@[_term] arrayByAddingObjectsFromArray:termForms];
-        NSDictionary* options = fields[_field][@"term_analysis"];
-        
-        return [self evalPredicate:[NSString stringWithFormat:@"ls %@ rs", _op]
-                              args:@{@"ls" : @([self termCount:input[_field] forms:terms options:options]),
-                                     @"rs" : _value ?: [NSNull null]}];
-    }
-    if (input[_field]) {
-        return [self evalPredicate:[NSString stringWithFormat:@"ls %@ rs", _op]
-                              args:@{ @"ls" : input[_field], @"rs" : _value ?: [NSNull null]}];
+    const FieldValue* value = &values[_fieldIndex];
+    if (value->isNumber && _valueIsNumber && !_term &&
+        _operatorCode >= PredicateOperatorLessThan && _operatorCode <= PredicateOperatorGreaterThan) {
+        return PredicateCompareNumbers(_operatorCode, value->number, _numericValue);
     }
-    NSAssert(NO, @"Predicate apply: Should not be here!");
-    return NO;
+    return [self applyToInputValue:value->object fields:fields];
 }
 
 @end
@@ -288,13 +479,27 @@ NSString* plural(NSString* string, int multiplicity) {
 
     NSMutableArray* rules = [@[] mutableCopy];
     for (Predicate* p in _predicates) {
-        if ([p.op isEqualToString:@"TRUE"]) {
+        if (![p.op isEqualToString:@"TRUE"]) {
             [rules addObject:[p ruleWithFields:fields label:label]];
         }
     }
     return [rules componentsJoinedByString:@" and "];
 }
 
+- (void)prepareWithFields:(NSDictionary*)fields {
+    
+    for (Predicate* p in _predicates) {
+        [p prepareWithFields:fields];
+    }
+}
+
+- (void)bindToSchema:(FieldSchema*)schema {
+    
+    for (Predicate* p in _predicates) {
+        [p bindToSchema:schema];
+    }
+}
+
 - (BOOL)apply:(NSDictionary*)input fields:(NSDictionary*)fields {
 
     BOOL result = YES;
@@ -304,4 +509,13 @@ NSString* plural(NSString* string, int multiplicity) {
     return result;
 }
 
+- (BOOL)applyToValues:(const FieldValue*)values fields:(NSDictionary*)fields {
+    
+    for (Predicate* p in _predicates) {
+        if (![p applyToValues:values fields:fields])
+            return NO;
+    }
+    return YES;
+}
+
 @end
@@ -23,10 +23,4 @@
 
 - (instancetype)initWithCluster:(NSDictionary*)dict;
 
-- (float) distance2WithInputData:(NSDictionary*)inputData
-                     uniqueTerms:(NSMutableDictionary*)termSets
-                          scales:(NSDictionary*)scales
-                 nearestDistance:(float)stopDistance2;
-
-
 @end
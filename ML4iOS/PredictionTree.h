@@ -27,6 +27,17 @@
 @property (nonatomic) BOOL isPredicate;
 @property (nonatomic) NSInteger maxBins;
 @property (nonatomic, readonly) NSArray* objectiveFields;
+@property (nonatomic, readonly) NSArray* children;
+
+/**
+ * The distribution of this node as a dictionary, and the Wilson score
+ * confidence and probability of each of its categories, in distribution
+ * order. They are computed once when the tree is built; the per-category
+ * arrays are nil for regression nodes.
+ */
+@property (nonatomic, readonly) NSDictionary* distributionDictionary;
+@property (nonatomic, readonly) NSArray* categoryConfidences;
+@property (nonatomic, readonly) NSArray* categoryProbabilities;
 
 /**
  * Initializes a PredictionTree object
@@ -43,6 +54,26 @@
                             subtree:(BOOL)subtree
                             maxBins:(NSInteger)maxBins;
 
+/**
+ * Initializes a node of a tree that is built while its JSON is read, e.g. by
+ * a JSONReader node builder, so that its children are already built. The
+ * tree cannot predict until finishWithFields:objectiveField:idsMap: is
+ * called on its root.
+ * @param node The JSON node, without its children
+ * @param children The PredictionTree instances of the node's children
+ */
+- (instancetype)initWithNode:(NSDictionary*)node children:(NSArray*)children;
+
+/**
+ * Binds a tree built with initWithNode:children: to the fields of its model,
+ * which are only known once the whole JSON is read, preparing the
+ * predicates of all of its nodes.
+ * @param idsMap Filled with the nodes of the tree, keyed by node Id
+ */
+- (void)finishWithFields:(NSDictionary*)fields
+          objectiveField:(NSString*)objectiveField
+                  idsMap:(NSMutableDictionary*)idsMap;
+
 /**
  * Create the prediction with current model and input data passed as parameter
  * @param inputData The input data to create the prediction
@@ -63,7 +94,26 @@
                   strategy:(MissingStrategy)strategy;
 
 /**
- * Checks if the subtree structure can be a regression
+ * Makes a prediction based on a number of field values. When withPath is NO
+ * no decision path is recorded; otherwise it is rendered the first time the
+ * path property of the returned prediction is read.
+ *
+ * The input fields must be keyed by Id.
+ */
+- (TreePrediction*)predict:(NSDictionary*)inputData
+                  strategy:(MissingStrategy)strategy
+                  withPath:(BOOL)withPath;
+
+/**
+ * Builds the prediction issued when a tree walk stops at this node
+ *
+ * @param path The rules followed to reach this node
+ */
+- (TreePrediction*)predictionWithPath:(NSMutableArray*)path;
+
+/**
+ * Checks if the subtree structure can be a regression. This is computed
+ * once when the tree is built.
  *
  * @return true if it's a regression or false if it's a classification
  */
@@ -31,6 +31,9 @@ typedef PredictionTree TreeHolder;
 @property (nonatomic, strong) NSArray* distribution;
 @property (nonatomic, strong) NSString* distributionUnit;
 @property (nonatomic, strong) NSArray* children;
+@property (nonatomic, strong) NSDictionary* distributionDictionary;
+@property (nonatomic, strong) NSArray* categoryConfidences;
+@property (nonatomic, strong) NSArray* categoryProbabilities;
 
 @end
 
@@ -44,6 +47,10 @@ typedef PredictionTree TreeHolder;
     long _count;
     double _impurity;
     NSDictionary* _rootDistribution;
+    BOOL _isRegression;
+    NSDictionary* _subtreeDistribution;
+    NSSet* _subtreeSplitFields;
+    BOOL _subtreeForcesBranch;
 }
 
 @synthesize predicate = _predicate;
@@ -62,31 +69,8 @@ typedef PredictionTree TreeHolder;
         
         _fields = fields;
         _objectiveFields = objectiveFields;
-        
-        _output = root[@"output"];
-        _confidence = [root[@"confidence"] doubleValue];
         rootDistribution = rootDistribution;
         
-        NSObject* predicateObj = root[@"predicate"];
-        
-        if ([predicateObj respondsToSelector:@selector(boolValue)] &&
-            [(NSNumber*)predicateObj boolValue] == YES) {
-            _isPredicate = YES;
-        } else {
-            
-            NSDictionary* predicateDict = (NSDictionary*)predicateObj;
-            self.predicate = [[Predicate alloc] initWithOperator:predicateDict[@"operator"]
-                                                         field:predicateDict[@"field"]
-                                                         value:predicateDict[@"value"]
-                                                          term:predicateDict[@"term"]];
-        }
-        
-        if (root[@"id"]) {
-            _nodeId = root[@"id"];
-            _parentId = parentId;
-            [idsMap setObject:self forKey:_nodeId];
-        }
-        
         //-- Generate children array
         NSMutableArray* children = [[NSMutableArray alloc] init];
         for (NSDictionary* child in root[@"children"]) {
@@ -96,44 +80,113 @@ typedef PredictionTree TreeHolder;
                                                fields:_fields
                                       objectiveFields:_objectiveFields
                                      rootDistribution:nil
-                                             parentId:_nodeId
+                                             parentId:root[@"id"]
                                                idsMap:idsMap
                                               subtree:subtree
                                               maxBins:maxBins];
             [children addObject:childTree];
         }
-        _children = children;
         
-        _count = [root[@"count"] integerValue];
-        _confidence = [root[@"confidence"] doubleValue];
-        _distribution = nil;
-        _distributionUnit = nil;
+        [self setUpWithNode:root children:children];
+        [self.predicate prepareWithFields:fields];
+        if (_nodeId) {
+            _parentId = parentId;
+            [idsMap setObject:self forKey:_nodeId];
+        }
+    }
+    
+    return self;
+}
+
+- (instancetype)initWithNode:(NSDictionary*)node children:(NSArray*)children {
+    
+    if (self = [super init]) {
         
-        NSDictionary* summary = nil;
-        NSArray* distributionObject = root[@"distribution"];
-        if (distributionObject) {
-            _distribution = distributionObject;
-        } else {
-            summary = [self setDistributionFromSummary:root[@"objective_summary"]];
+        [self setUpWithNode:node children:children];
+        for (PredictionTree* child in _children) {
+            child->_parentId = _nodeId;
         }
+    }
+    return self;
+}
+
+/**
+ * Reads what a node holds besides its children, which are already built,
+ * and computes everything that depends only on the node and its subtree
+ */
+- (void)setUpWithNode:(NSDictionary*)root children:(NSArray*)children {
+    
+    _output = root[@"output"];
+    _confidence = [root[@"confidence"] doubleValue];
+    
+    NSObject* predicateObj = root[@"predicate"];
+    
+    if ([predicateObj respondsToSelector:@selector(boolValue)] &&
+        [(NSNumber*)predicateObj boolValue] == YES) {
+        _isPredicate = YES;
+    } else {
         
-        if ([self isRegression]) {
-            _maxBins = MAX(_maxBins, _distribution.count);
-            _median = NAN;
-            
-            if (summary) {
-                _median = [summary[@"median"] doubleValue];
-            }
-            if (isnan(_median)) {
-                _median = [self medianForDistribution:_distribution count:_count];
-            }
+        NSDictionary* predicateDict = (NSDictionary*)predicateObj;
+        self.predicate = [[Predicate alloc] initWithOperator:predicateDict[@"operator"]
+                                                     field:predicateDict[@"field"]
+                                                     value:predicateDict[@"value"]
+                                                      term:predicateDict[@"term"]];
+    }
+    
+    _nodeId = root[@"id"];
+    _children = children;
+    
+    _count = [root[@"count"] integerValue];
+    _distribution = nil;
+    _distributionUnit = nil;
+    
+    NSDictionary* summary = nil;
+    NSArray* distributionObject = root[@"distribution"];
+    if (distributionObject) {
+        _distribution = distributionObject;
+    } else {
+        summary = [self setDistributionFromSummary:root[@"objective_summary"]];
+    }
+    
+    _isRegression = [self subtreeIsRegression];
+    if (_isRegression) {
+        _maxBins = MAX(_maxBins, _distribution.count);
+        _median = NAN;
+        
+        if (summary) {
+            _median = [summary[@"median"] doubleValue];
         }
-        if (![self isRegression] && _distribution) {
-            _impurity = [self giniImpurity:_distribution count:_count];
+        if (isnan(_median)) {
+            _median = [self medianForDistribution:_distribution count:_count];
         }
     }
+    if (!_isRegression && _distribution) {
+        _impurity = [self giniImpurity:_distribution count:_count];
+    }
+    [self computeDistributionOutputs];
+    [self computeSubtreeAggregates];
+}
+
+- (void)finishWithFields:(NSDictionary*)fields
+          objectiveField:(NSString*)objectiveField
+                  idsMap:(NSMutableDictionary*)idsMap {
     
-    return self;
+    [self finishWithFields:fields objectiveFields:@[objectiveField] idsMap:idsMap];
+}
+
+- (void)finishWithFields:(NSDictionary*)fields
+         objectiveFields:(NSArray*)objectiveFields
+                  idsMap:(NSMutableDictionary*)idsMap {
+    
+    _fields = fields;
+    _objectiveFields = objectiveFields;
+    [_predicate prepareWithFields:fields];
+    if (_nodeId) {
+        [idsMap setObject:self forKey:_nodeId];
+    }
+    for (PredictionTree* child in _children) {
+        [child finishWithFields:fields objectiveFields:objectiveFields idsMap:idsMap];
+    }
 }
 
 /**
@@ -196,11 +249,12 @@ typedef PredictionTree TreeHolder;
 }
 
 /**
- * Checks if the subtree structure can be a regression
+ * Checks if the subtree structure can be a regression. The result is
+ * computed once at build time and returned by isRegression.
  *
  * @return true if it's a regression or false if it's a classification
  */
-- (BOOL)isRegression {
+- (BOOL)subtreeIsRegression {
     
     if ([self isClassification:self]) {
         return NO;
@@ -219,6 +273,44 @@ typedef PredictionTree TreeHolder;
     return true;
 }
 
+- (BOOL)isRegression {
+    return _isRegression;
+}
+
+/**
+ * Precomputes what a prediction stopping at this node outputs for each
+ * category of its distribution: the distribution as a dictionary, and the
+ * Wilson score confidence and probability of each category (in
+ * distribution order). Regression nodes only get the dictionary.
+ */
+- (void)computeDistributionOutputs {
+    
+    if (!_distribution)
+        return;
+    
+    _distributionDictionary = [[ML4iOSUtils dictionaryFromDistributionArray:_distribution] copy];
+    if (_isRegression)
+        return;
+    
+    double total = 0.0;
+    for (NSNumber* instances in _distributionDictionary.allValues) {
+        total += [instances doubleValue];
+    }
+    //-- wsConfidence is undefined for an empty distribution
+    if (total <= 0.0)
+        return;
+    
+    NSMutableArray* confidences = [NSMutableArray arrayWithCapacity:_distribution.count];
+    NSMutableArray* probabilities = [NSMutableArray arrayWithCapacity:_distribution.count];
+    for (NSArray* distributionElement in _distribution) {
+        [confidences addObject:@([ML4iOSUtils wsConfidence:distributionElement.firstObject
+                                             distribution:_distributionDictionary])];
+        [probabilities addObject:@([distributionElement.lastObject doubleValue] / _count)];
+    }
+    _categoryConfidences = confidences;
+    _categoryProbabilities = probabilities;
+}
+
 /**
  * Sets internal properties based on the passed summary.
  * If no summary is given, it uses the _rootDistribution.
@@ -291,6 +383,62 @@ typedef PredictionTree TreeHolder;
     return  NO;
 }
 
+/**
+ * Precomputes, for the proportional missing strategy, the distribution
+ * obtained by merging all the leaves of this subtree, the set of fields
+ * split on anywhere in it, and whether any of its splits has a missing-valued
+ * or null-valued predicate. Children are built first, so their aggregates
+ * are already available.
+ */
+- (void)computeSubtreeAggregates {
+    
+    if (_children.count == 0) {
+        _subtreeDistribution = _distributionDictionary ?: @{};
+        return;
+    }
+    
+    NSMutableDictionary* distribution = [NSMutableDictionary new];
+    NSMutableSet* splitFields = [NSMutableSet new];
+    BOOL forcesBranch = [self missingBranch:_children] || [self noneValue:_children];
+    for (PredictionTree* child in _children) {
+        [ML4iOSUtils mergeDistribution:distribution andDistribution:child->_subtreeDistribution];
+        if (![child isPredicate] && child.predicate.field) {
+            [splitFields addObject:child.predicate.field];
+        }
+        if (child->_subtreeSplitFields) {
+            [splitFields unionSet:child->_subtreeSplitFields];
+        }
+        forcesBranch = forcesBranch || child->_subtreeForcesBranch;
+    }
+    _subtreeDistribution = [distribution copy];
+    _subtreeSplitFields = [splitFields copy];
+    _subtreeForcesBranch = forcesBranch;
+}
+
+/**
+ * Checks whether a proportional prediction from this node would merge all
+ * the leaves of its subtree, i.e. no split below it can select a single
+ * branch for the given input.
+ */
+- (BOOL)mergesWholeSubtree:(NSDictionary*)inputData {
+    
+    if (_children.count == 0 || _subtreeForcesBranch)
+        return NO;
+    
+    if (inputData.count < _subtreeSplitFields.count) {
+        for (NSString* field in inputData) {
+            if ([_subtreeSplitFields containsObject:field])
+                return NO;
+        }
+    } else {
+        for (NSString* field in _subtreeSplitFields) {
+            if (inputData[field])
+                return NO;
+        }
+    }
+    return YES;
+}
+
 /**
  * Check if there's only one branch to be followed
  *
@@ -314,34 +462,35 @@ typedef PredictionTree TreeHolder;
  *  reached by a unique path.
  *
  * @param inputData
- * @param path
+ * @param pathPredicates the predicates followed while the path is unique, or nil
  * @param missingFound
  * @return
  */
 - (NSDictionary*)predictProportional:(NSDictionary*)inputData
                             lastNode:(TreeHolder**)lastNode
-                                path:(NSMutableArray*)path
+                      pathPredicates:(NSMutableArray*)pathPredicates
                         missingFound:(BOOL)missingFound
                               median:(BOOL)median {
 
-    if (!path)
-        path = [NSMutableArray new];
-    
     NSMutableDictionary* finalDistribution = [NSMutableDictionary new];
     if (_children.count == 0) {
         *lastNode = self;
         return [ML4iOSUtils dictionaryFromDistributionArray:_distribution];
     }
+    //-- no split below can be decided: all the leaves would be merged
+    if ([self mergesWholeSubtree:inputData]) {
+        *lastNode = self;
+        return _subtreeDistribution;
+    }
     if ([self isOneBranch:_children inputData:inputData]) {
         for (PredictionTree* child in _children) {
             if ([child.predicate apply:inputData fields:_fields]) {
-                NSString* newRule = [child.predicate ruleWithFields:_fields label:nil];
-                if (![path containsObject:newRule] && !missingFound) {
-                    [path addObject:newRule];
+                if (!missingFound) {
+                    [pathPredicates addObject:child.predicate];
                 }
                 return [child predictProportional:inputData
                                          lastNode:lastNode
-                                             path:path
+                                   pathPredicates:pathPredicates
                                      missingFound:missingFound
                                            median:median];
             }
@@ -354,7 +503,7 @@ typedef PredictionTree TreeHolder;
                                  mergeDistribution:finalDistribution
                                  andDistribution:[child predictProportional:inputData
                                                                    lastNode:lastNode
-                                                                       path:path
+                                                             pathPredicates:pathPredicates
                                                                missingFound:missingFound
                                                                      median:median]];
         }
@@ -376,48 +525,51 @@ typedef PredictionTree TreeHolder;
     return count;
 }
 
+- (TreePrediction*)predictionWithPath:(NSMutableArray*)path {
+    
+    TreePrediction* prediction =
+    [TreePrediction treePrediction:_output
+                        confidence:_confidence
+                             count:_count
+                            median:(_isRegression?_median:NAN)
+                              path:path
+                      distribution:_distribution
+                  distributionUnit:_distributionUnit
+                          children:_children];
+    prediction.distributionDictionary = _distributionDictionary;
+    prediction.categoryConfidences = _categoryConfidences;
+    prediction.categoryProbabilities = _categoryProbabilities;
+    return prediction;
+}
+
 /**
- * Makes a prediction based on a number of field values.
- *
- * The input fields must be keyed by Id.
- *
- * .predict({"petal length": 1})
- *
+ * Walks the tree collecting the predicates followed in pathPredicates
+ * (unless it is nil). Rules are rendered from them only when needed.
  */
 - (TreePrediction*)predict:(NSDictionary*)inputData
-                      path:(NSMutableArray*)path
+            pathPredicates:(NSMutableArray*)pathPredicates
                   strategy:(MissingStrategy)strategy {
 
-    if (!path)
-        path = [NSMutableArray new];
-    
     if (strategy == MissingStrategyLastPrediction) {
         if (_children.count > 0) {
             for (PredictionTree* child in _children) {
                 if ([child.predicate apply:inputData fields:_fields]) {
-                    [path addObject:[child.predicate ruleWithFields:_fields label:nil]];
-                    return [child predict:inputData path:path strategy:strategy];
+                    [pathPredicates addObject:child.predicate];
+                    return [child predict:inputData pathPredicates:pathPredicates strategy:strategy];
                 }
             }
         }
-        return [TreePrediction treePrediction:_output
-                                   confidence:_confidence
-                                        count:_count
-                                       median:([self isRegression]?_median:NAN)
-                                         path:path
-                                 distribution:_distribution
-                             distributionUnit:_distributionUnit
-                                     children:_children];
+        return [self predictionWithPath:nil];
         
     } else if (strategy == MissingStrategyProportional) {
 
         TreeHolder* lastNode = [TreeHolder new];
         NSDictionary* finalDistribution = [self predictProportional:inputData
                                                            lastNode:&lastNode
-                                                               path:path
+                                                     pathPredicates:pathPredicates
                                                        missingFound:NO
                                                              median:NO];
-        if ([self isRegression]) {
+        if (_isRegression) {
             if (finalDistribution.count == 1) {
                 NSAssert([finalDistribution.allValues.firstObject isKindOfClass:[NSArray class]] &&
                          [finalDistribution.allValues.firstObject count] == 2,
@@ -428,7 +580,7 @@ typedef PredictionTree TreeHolder;
                                                confidence:lastNode.confidence
                                                     count:instances
                                                    median:lastNode.median
-                                                     path:path
+                                                     path:nil
                                              distribution:lastNode.distribution
                                          distributionUnit:lastNode.distributionUnit
                                                  children:lastNode.children];
@@ -450,7 +602,7 @@ typedef PredictionTree TreeHolder;
                     confidence:confidence
                     count:totalInstances
                     median:[ML4iOSUtils medianOfDistribution:distribution instances:totalInstances]
-                    path:path
+                    path:nil
                     distribution:distribution
                     distributionUnit:distributionUnit
                     children:lastNode.children];
@@ -466,7 +618,7 @@ typedef PredictionTree TreeHolder;
                                                         distribution:finalDistribution]
                                             count:totalInstances
                                            median:NAN
-                                             path:path
+                                             path:nil
                                      distribution:distribution
                                  distributionUnit:_distributionUnit
                                          children:lastNode.children];
@@ -477,6 +629,42 @@ typedef PredictionTree TreeHolder;
     return nil;
 }
 
+/**
+ * Makes a prediction based on a number of field values.
+ *
+ * The input fields must be keyed by Id.
+ *
+ * .predict({"petal length": 1})
+ *
+ */
+- (TreePrediction*)predict:(NSDictionary*)inputData
+                      path:(NSMutableArray*)path
+                  strategy:(MissingStrategy)strategy {
+    
+    TreePrediction* prediction = [self predict:inputData strategy:strategy withPath:YES];
+    if (path) {
+        [path addObjectsFromArray:prediction.path];
+        prediction.path = path;
+    }
+    return prediction;
+}
+
+- (TreePrediction*)predict:(NSDictionary*)inputData
+                  strategy:(MissingStrategy)strategy
+                  withPath:(BOOL)withPath {
+    
+    NSMutableArray* pathPredicates = withPath ? [NSMutableArray new] : nil;
+    TreePrediction* prediction = [self predict:inputData
+                                pathPredicates:pathPredicates
+                                      strategy:strategy];
+    if (pathPredicates) {
+        [prediction setPathPredicates:pathPredicates
+                               fields:_fields
+                          uniqueRules:(strategy == MissingStrategyProportional)];
+    }
+    return prediction;
+}
+
 - (TreePrediction*)predict:(NSDictionary*)inputData
                       path:(NSMutableArray*)path {
     
@@ -28,8 +28,57 @@
 
 @interface PredictiveCluster : NSObject
 
+/**
+ * The PredictionCentroid instances of the cluster. Centroid indexes
+ * returned by the methods below refer to this array.
+ */
+@property (nonatomic, readonly) NSArray* centroids;
+
 + (NSDictionary*)predictWithJSONCluster:(NSDictionary*)jsonCluster
                               arguments:(NSDictionary*)args
                                 options:(NSDictionary*)options;
 
+- (instancetype)initWithCluster:(NSDictionary*)resourceDict;
+
+/**
+ * Assigns many rows to their nearest centroids, spreading blocks of rows
+ * across cores. When the cluster has no text fields, the distances between
+ * centroids are used to skip those that cannot be the nearest one. Results
+ * are the same as those of predictWithJSONCluster:arguments:options:.
+ * @param rows The input data of each row
+ * @param options A dictionary of options:
+ *        - byName: YES when rows are keyed by field names (default NO, keyed
+ *          by field Ids).
+ *        - threads: Maximum number of concurrent workers (default 0, one
+ *          per active processor; 1 assigns serially).
+ * @return One dictionary per row, in order, with its "centroidId",
+ *         "centroidName" and "distance"
+ */
+- (NSArray*)computeNearestForRows:(NSArray*)rows options:(NSDictionary*)options;
+
+/**
+ * Finds the k centroids nearest to an input, in a single pass over the
+ * centroids that only keeps the k best ones.
+ * @param options The byName option of computeNearestForRows:options:
+ * @param indexes A buffer of k indexes in centroids, filled nearest first.
+ *        Equally distant centroids are ordered by index.
+ * @param distances A buffer of k distances, in the same order
+ * @return The number of centroids found, at most k
+ */
+- (NSUInteger)nearestCentroids:(NSUInteger)k
+                       toInput:(NSDictionary*)input
+                       options:(NSDictionary*)options
+                       indexes:(NSUInteger*)indexes
+                     distances:(double*)distances;
+
+/**
+ * Computes the distance from an input to every centroid.
+ * @param options The byName option of computeNearestForRows:options:
+ * @param distances A buffer of centroids.count distances, filled in the
+ *        order of centroids
+ */
+- (void)distancesToInput:(NSDictionary*)input
+                 options:(NSDictionary*)options
+                    into:(double*)distances;
+
 @end
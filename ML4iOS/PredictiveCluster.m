@@ -14,18 +14,123 @@
 
 #import "PredictiveCluster.h"
 #import "PredictionCentroid.h"
+#import "FieldSchema.h"
+#import "CentroidMatrix.h"
 
 #define TM_TOKENS @"tokens_only"
 #define TM_FULL_TERM @"full_terms_only"
 
+typedef enum ClusterTokenMode {
+    
+    ClusterTokenModeAll,
+    ClusterTokenModeTokensOnly,
+    ClusterTokenModeFullTermsOnly
+    
+} ClusterTokenMode;
+
+/**
+ * The text analysis of a text field of a cluster, read once from the field's
+ * term_analysis and summary, so that analyzing an input only takes its
+ * tokenization and hash lookups.
+ */
+@interface ClusterTextAnalyzer : NSObject
+
+@property (nonatomic, readonly) NSString* fieldId;
+@property (nonatomic, readonly) BOOL caseSensitive;
+@property (nonatomic, readonly) ClusterTokenMode tokenMode;
+
+- (instancetype)initWithFieldId:(NSString*)fieldId field:(NSDictionary*)field;
+
+/**
+ * The unique tag cloud terms of the given text, with every term form
+ * replaced by its term
+ */
+- (NSArray*)uniqueTermsIn:(NSString*)text;
+
+@end
+
+@implementation ClusterTextAnalyzer {
+    
+    //-- every form of a term, and the term itself, mapped to the term
+    NSDictionary* _extendedForms;
+    NSSet* _tags;
+}
+
+- (instancetype)initWithFieldId:(NSString*)fieldId field:(NSDictionary*)field {
+    
+    if (self = [super init]) {
+        
+        _fieldId = fieldId;
+        
+        NSDictionary* termAnalysis = field[@"term_analysis"];
+        _caseSensitive = [termAnalysis[@"case_sensitive"] boolValue];
+        NSString* tokenMode = termAnalysis[@"token_mode"];
+        if ([tokenMode isEqualToString:TM_TOKENS]) {
+            _tokenMode = ClusterTokenModeTokensOnly;
+        } else if ([tokenMode isEqualToString:TM_FULL_TERM]) {
+            _tokenMode = ClusterTokenModeFullTermsOnly;
+        } else {
+            _tokenMode = ClusterTokenModeAll;
+        }
+        
+        NSDictionary* termForms = field[@"summary"][@"term_forms"];
+        NSMutableDictionary* extendedForms = [NSMutableDictionary dictionary];
+        for (NSString* term in termForms) {
+            for (NSString* termForm in termForms[term]) {
+                extendedForms[termForm] = term;
+            }
+            extendedForms[term] = term;
+        }
+        _extendedForms = extendedForms;
+        
+        //-- tag cloud entries are [term, count] pairs
+        NSArray* tagCloud = field[@"summary"][@"tag_cloud"];
+        NSMutableSet* tags = [NSMutableSet setWithCapacity:tagCloud.count];
+        for (id tag in tagCloud) {
+            id term = [tag isKindOfClass:[NSArray class]] ? [tag firstObject] : tag;
+            if (term)
+                [tags addObject:term];
+        }
+        _tags = tags;
+    }
+    return self;
+}
+
+- (NSArray*)uniqueTermsIn:(NSString*)text {
+    
+    if (![text isKindOfClass:[NSString class]])
+        return @[];
+    if (!_caseSensitive)
+        text = [text lowercaseString];
+    
+    NSMutableArray* terms = [NSMutableArray array];
+    if (_tokenMode != ClusterTokenModeFullTermsOnly)
+        [terms addObjectsFromArray:[text componentsSeparatedByCharactersInSet:[NSCharacterSet whitespaceCharacterSet]]];
+    if (_tokenMode != ClusterTokenModeTokensOnly)
+        [terms addObject:text];
+    
+    NSMutableOrderedSet* termSet = [NSMutableOrderedSet orderedSetWithCapacity:terms.count];
+    for (NSString* term in terms) {
+        if ([_tags containsObject:term]) {
+            [termSet addObject:term];
+        } else if (_extendedForms[term]) {
+            [termSet addObject:_extendedForms[term]];
+        }
+    }
+    return termSet.array;
+}
+
+@end
+
 @interface PredictiveCluster ()
 
 @property (nonatomic, strong) NSDictionary* fields;
-@property (nonatomic, strong) NSMutableDictionary* termForms;
-@property (nonatomic, strong) NSMutableDictionary* tagClouds;
-@property (nonatomic, strong) NSMutableDictionary* termAnalysis;
-@property (nonatomic, strong) NSMutableArray* centroids;
+//-- the analyzers of the text fields with a tag cloud
+@property (nonatomic, strong) NSMutableArray* textAnalyzers;
+@property (nonatomic, strong) NSArray* centroids;
 @property (nonatomic, strong) NSDictionary* scales;
+@property (nonatomic, strong) FieldSchema* schema;
+@property (nonatomic, strong) CentroidMatrix* matrix;
 
 //@property (nonatomic, strong) NSDictionary* invertedFields;
 @property (nonatomic, strong) NSString* clusterDescription;
@@ -61,26 +166,24 @@ to generate centroid predictions locally.
 
 - (void)fillStructureForResource:(NSDictionary*)resourceDict {
     
-    self.termForms = [NSMutableDictionary dictionary];
-    self.tagClouds = [NSMutableDictionary dictionary];
-    self.termAnalysis = [NSMutableDictionary dictionary];
+    self.textAnalyzers = [NSMutableArray array];
+    
+    self.scales = resourceDict[@"scales"];
+    NSDictionary* fields = resourceDict[@"clusters"][@"fields"];
+    self.schema = [[FieldSchema alloc] initWithFields:fields];
     
     NSDictionary* clusters = resourceDict[@"clusters"][@"clusters"];
-    self.centroids = [NSMutableArray array];
+    NSMutableArray* centroids = [NSMutableArray arrayWithCapacity:clusters.count];
     for (NSDictionary* cluster in clusters) {
-        [_centroids addObject:[[PredictionCentroid alloc] initWithCluster:cluster]];
+        [centroids addObject:[[PredictionCentroid alloc] initWithCluster:cluster]];
     }
-    self.scales = resourceDict[@"scales"];
-    NSDictionary* fields = resourceDict[@"clusters"][@"fields"];
+    self.centroids = centroids;
+    self.matrix = [[CentroidMatrix alloc] initWithCentroids:_centroids schema:_schema scales:_scales];
     for (NSString* fieldId in [fields allKeys]) {
         
         NSDictionary* field = fields[fieldId];
-        if ([field[@"optype"] isEqualToString:@"text"]) {
-            if (field[@"summary"][@"term_forms"])
-                self.termForms[fieldId] = field[@"summary"][@"term_forms"]; //-- cannot be found
-            if (field[@"summary"][@"tag_cloud"])
-                self.tagClouds[fieldId] = field[@"summary"][@"tag_cloud"]; //-- cannot be found
-            self.termAnalysis[fieldId] = field[@"term_analysis"];
+        if ([field[@"optype"] isEqualToString:@"text"] && field[@"summary"][@"tag_cloud"]) {
+            [_textAnalyzers addObject:[[ClusterTextAnalyzer alloc] initWithFieldId:fieldId field:field]];
         }
     }
     self.fields = fields;
@@ -99,90 +202,171 @@ to generate centroid predictions locally.
     return self;
 }
 
-- (NSMutableArray*)parsePhrase:(NSString*)phrase isCaseSensitive:(BOOL)isCaseSensitive {
- 
-    NSMutableArray* words = [[phrase componentsSeparatedByCharactersInSet:[NSCharacterSet  whitespaceCharacterSet]] mutableCopy];
+- (NSDictionary*)resultForNearest:(NSUInteger)nearest distance2:(float)distance2 {
     
-    if (!isCaseSensitive) {
-        for (short i = 0; i < words.count; ++i) {
-            words[i] = [words[i] lowercaseString];
-        }
+    if (nearest == NSNotFound) {
+        return @{ @"centroidId":@"",
+                  @"centroidName":@"",
+                  @"distance":@(INFINITY) };
     }
-    return words;
+    
+    PredictionCentroid* centroid = self.centroids[nearest];
+    return @{ @"centroidId":@(centroid.centroidId),
+              @"centroidName":centroid.name,
+              @"distance":@(sqrt(distance2)) };
 }
 
-- (NSMutableArray*)uniqueTermsIn:(NSArray*)terms
-                       termForms:(NSDictionary*)termForms
-                          filter:(NSArray*)filter {
- 
-    NSMutableDictionary* extendForms = [NSMutableDictionary dictionary];
-    NSMutableArray* termSet = [NSMutableArray array];
-    NSMutableArray* tagTerms = [NSMutableArray array];
+/**
+ * The unique terms of each text field of the input, indexed by schema
+ * (NSNull for other fields)
+ */
+- (NSArray*)uniqueTermsOf:(NSDictionary*)inputData {
     
-    for (id term in filter)
-        [tagTerms addObject:term];
-    
-    for (id term in [termForms allKeys]) {
-        for (id termForm in term) {
-            extendForms[termForm] = term;
-        }
+    NSMutableArray* uniqueTerms = [NSMutableArray arrayWithCapacity:_schema.count];
+    for (NSUInteger i = 0; i < _schema.count; ++i) {
+        [uniqueTerms addObject:[NSNull null]];
     }
-    for (id term in terms) {
-        if ([termSet indexOfObject:term] == NSNotFound && [tagTerms indexOfObject:term] != NSNotFound) {
-            [termSet addObject:term];
-        } else if ([termSet indexOfObject:termSet] == NSNotFound && extendForms[term]) {
-            [termSet addObject:extendForms[term]];
+    
+    for (ClusterTextAnalyzer* analyzer in _textAnalyzers) {
+        
+        NSUInteger fieldIndex = [_schema indexOfFieldId:analyzer.fieldId];
+        if (fieldIndex != NSNotFound) {
+            uniqueTerms[fieldIndex] = [analyzer uniqueTermsIn:inputData[analyzer.fieldId]];
         }
     }
+    return uniqueTerms;
+}
+
+/**
+ * The input keyed by field Id, mapping field names when byName is set
+ */
+- (NSDictionary*)inputDataById:(NSDictionary*)inputData byName:(BOOL)byName {
     
-    return termSet;
+    if (!byName)
+        return inputData;
+    
+    NSMutableDictionary* byId = [NSMutableDictionary dictionaryWithCapacity:_fields.count];
+    for (NSString* fieldId in _fields) {
+        id value = inputData[_fields[fieldId][@"name"]];
+        if (value)
+            byId[fieldId] = value;
+    }
+    return byId;
 }
 
 - (NSDictionary*)computeNearest:(NSDictionary*)inputData {
     
-    NSMutableArray* terms = nil;
-    NSMutableDictionary* uniqueTerms = [NSMutableDictionary dictionary];
+    FieldValue* values = FieldValuesAlloc(_schema.count);
+    NSDictionary* result = [self computeNearest:inputData values:values];
+    free(values);
+    return result;
+}
+
+/**
+ * Same as computeNearest:, binding the input into the given buffer of
+ * schema.count values
+ */
+- (NSDictionary*)computeNearest:(NSDictionary*)inputData values:(FieldValue*)values {
+    
+    NSArray* uniqueTerms = [self uniqueTermsOf:inputData];
+    [_schema bindInput:inputData values:values];
     
-    for (NSString* fieldId in [self.tagClouds allKeys]) {
-        
-        BOOL isCaseSensitive = [self.termAnalysis[fieldId][@"case_sensitive"] boolValue];
-        NSString* tokenMode = self.termAnalysis[fieldId][@"tokenMode"];
-        NSString* inputDataField = inputData[fieldId];
-        if (![tokenMode isEqualToString:TM_FULL_TERM]) {
-            terms = [self parsePhrase:inputDataField isCaseSensitive:isCaseSensitive];
-        } else {
-            terms = [NSMutableArray array];
-        }
-        if (![tokenMode isEqualToString:TM_TOKENS]) {
-            [terms addObject:(isCaseSensitive ? inputDataField : [inputDataField lowercaseString])];
+    float distance2 = INFINITY;
+    NSUInteger nearest = [_matrix nearestToValues:values uniqueTerms:uniqueTerms distance2:&distance2];
+    return [self resultForNearest:nearest distance2:distance2];
+}
+
+- (NSArray*)computeNearestForRows:(NSArray*)rows options:(NSDictionary*)options {
+    
+    BOOL byName = [options[@"byName"] ?: @(NO) boolValue];
+    NSUInteger threads = [options[@"threads"] ?: @(0) unsignedIntegerValue];
+    
+    NSUInteger count = rows.count;
+    NSUInteger workers = threads ?: [[NSProcessInfo processInfo] activeProcessorCount];
+    workers = MAX(MIN(workers, count), 1);
+    
+    CentroidMatrix* matrix = self.matrix;
+    FieldSchema* schema = self.schema;
+    
+    //-- each worker assigns a contiguous block of rows into its own buffer,
+    //-- so that concatenating the buffers keeps the rows' order
+    NSMutableArray* buffers = [NSMutableArray arrayWithCapacity:workers];
+    for (NSUInteger worker = 0; worker < workers; ++worker) {
+        [buffers addObject:[NSMutableArray arrayWithCapacity:count / workers + 1]];
+    }
+    void(^evaluate)(size_t) = ^(size_t worker) {
+        NSMutableArray* buffer = buffers[worker];
+        FieldValue* values = FieldValuesAlloc(schema.count);
+        NSUInteger hint = 0;
+        NSUInteger last = (worker + 1) * count / workers;
+        for (NSUInteger i = worker * count / workers; i < last; ++i) {
+            @autoreleasepool {
+                NSDictionary* inputData = [self inputDataById:rows[i] byName:byName];
+                if (matrix.metric) {
+                    //-- consecutive rows often share their centroid
+                    [schema bindInput:inputData values:values];
+                    float distance2 = INFINITY;
+                    NSUInteger nearest = [matrix nearestToValues:values hint:hint distance2:&distance2];
+                    if (nearest != NSNotFound)
+                        hint = nearest;
+                    [buffer addObject:[self resultForNearest:nearest distance2:distance2]];
+                } else {
+                    [buffer addObject:[self computeNearest:inputData values:values]];
+                }
+            }
         }
-        uniqueTerms[fieldId] = [self uniqueTermsIn:terms
-                                         termForms:self.termForms[fieldId]
-                                            filter: self.tagClouds[fieldId]];
+        free(values);
+    };
+    if (workers == 1) {
+        evaluate(0);
+    } else {
+        dispatch_apply(workers, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), evaluate);
     }
     
-    NSDictionary* nearest = @{ @"centroidId":@"",
-                               @"centroidName":@"",
-                               @"distance":@(INFINITY) };
+    NSMutableArray* results = [NSMutableArray arrayWithCapacity:count];
+    for (NSArray* buffer in buffers) {
+        [results addObjectsFromArray:buffer];
+    }
+    return results;
+}
+
+- (NSUInteger)nearestCentroids:(NSUInteger)k
+                       toInput:(NSDictionary*)input
+                       options:(NSDictionary*)options
+                       indexes:(NSUInteger*)indexes
+                     distances:(double*)distances {
     
-    for (PredictionCentroid* centroid in self.centroids) {
-        
-        float distance2 = [centroid distance2WithInputData:inputData
-                                               uniqueTerms:uniqueTerms
-                                                    scales:self.scales
-                                           nearestDistance:[nearest[@"distance"] floatValue]];
-        
-        if (distance2 < [nearest[@"distance"] floatValue]) {
-            
-            nearest = @{ @"centroidId":@(centroid.centroidId),
-                         @"centroidName":centroid.name,
-                         @"distance":@(distance2) };
-        }
+    BOOL byName = [options[@"byName"] ?: @(NO) boolValue];
+    NSDictionary* inputData = [self inputDataById:input byName:byName];
+    
+    FieldValue* values = FieldValuesAlloc(_schema.count);
+    [_schema bindInput:inputData values:values];
+    NSUInteger count = [_matrix nearest:k
+                               toValues:values
+                            uniqueTerms:[self uniqueTermsOf:inputData]
+                                indexes:indexes
+                             distances2:distances];
+    free(values);
+    for (NSUInteger i = 0; i < count; ++i) {
+        distances[i] = sqrt(distances[i]);
     }
+    return count;
+}
+
+- (void)distancesToInput:(NSDictionary*)input
+                 options:(NSDictionary*)options
+                    into:(double*)distances {
     
-    return @{ @"centroidId":nearest[@"centroidId"],
-              @"centroidName":nearest[@"centroidName"],
-              @"distance":@(sqrt([nearest[@"distance"] floatValue])) };
+    BOOL byName = [options[@"byName"] ?: @(NO) boolValue];
+    NSDictionary* inputData = [self inputDataById:input byName:byName];
+    
+    FieldValue* values = FieldValuesAlloc(_schema.count);
+    [_schema bindInput:inputData values:values];
+    [_matrix distances2ToValues:values uniqueTerms:[self uniqueTermsOf:inputData] into:distances];
+    free(values);
+    for (NSUInteger i = 0; i < _centroids.count; ++i) {
+        distances[i] = sqrt(distances[i]);
+    }
 }
 
 - (id)makeCentroid:(NSDictionary*)inputData callback:(id(^)(NSError*, id))callback {
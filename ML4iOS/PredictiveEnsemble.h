@@ -18,10 +18,45 @@
 
 @property (nonatomic) BOOL isReadyToPredict;
 
+/**
+ * The PredictiveModel instances of all the members, in voting order
+ */
+@property (nonatomic, readonly) NSArray* models;
+
+/**
+ * Builds a local ensemble. The local models of all the members are built
+ * here, once, so the same instance should be kept to make any number of
+ * predictions with predictWithArguments:options:.
+ * @param models BigML models, or already built PredictiveModel instances
+ * @param maxModels Maximum number of models grouped in each MultiModel
+ *        (0 for all of them)
+ * @param distributions The distributions of the ensemble members
+ */
 - (instancetype)initWithModels:(NSArray*)models
                      maxModels:(NSUInteger)maxModels
                  distributions:(NSArray*)distributions;
 
+/**
+ * Makes a prediction combining the votes of all the members.
+ *
+ * Besides the options accepted by the members' predictions (byName,
+ * strategy, median...) and the combination options (method, confidence,
+ * distribution, count, min, max), it accepts:
+ *
+ *        - parallel: When YES, the members are evaluated concurrently.
+ *                    The result is the same as the serial evaluation.
+ *
+ *        - threads: Maximum number of concurrent workers used in parallel
+ *                   mode. Defaults to 0, one per active processor.
+ *
+ *        - earlyExit: When YES, for the plurality and threshold methods, the
+ *                     members vote one at a time and evaluation stops as soon
+ *                     as the remaining votes cannot change the winner. The
+ *                     prediction is the same as with all the votes, but the
+ *                     confidence and count only reflect the votes cast. The
+ *                     result includes "skippedModels", the number of members
+ *                     that were not evaluated. Takes precedence over parallel.
+ */
 - (NSDictionary*)predictWithArguments:(NSDictionary*)inputData
                                    options:(NSDictionary*)options;
 
@@ -17,10 +17,158 @@
 #import "MultiVote.h"
 #import "ML4iOSEnums.h"
 
+/**
+ * Counts the categorical votes of an ensemble as they arrive, to tell when
+ * the remaining votes can no longer change the plurality winner. Categories
+ * are kept in first vote order, which is how MultiVote breaks ties.
+ *
+ * The leader and the runner-up of the contest are updated with each vote,
+ * so telling whether the winner is decided does not depend on the number of
+ * categories.
+ */
+@interface PluralityTally : NSObject
+
+@property (nonatomic, readonly) NSUInteger votes;
+@property (nonatomic, readonly) BOOL isCategorical;
+
+/**
+ * @param capacity The number of votes to expect, which bounds the number
+ *        of categories
+ * @param category A category left out of the contest, as the threshold
+ *        method does with its category, or nil
+ */
+- (instancetype)initWithCapacity:(NSUInteger)capacity excludingCategory:(NSString*)category;
+
+- (void)addVote:(NSDictionary*)vote;
+- (BOOL)isDecidedWithRemaining:(NSUInteger)remaining;
+- (BOOL)isDecidedWithRemaining:(NSUInteger)remaining threshold:(NSUInteger)threshold;
+
+@end
+
+@implementation PluralityTally {
+    
+    NSMutableDictionary* _categoryIndexes;
+    NSString* _excludedCategory;
+    NSUInteger* _counts;
+    NSUInteger _capacity;
+    NSUInteger _categoryCount;
+    NSUInteger _excluded;
+    NSUInteger _leader;
+    NSUInteger _runnerUp;
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity excludingCategory:(NSString*)category {
+    
+    if (self = [super init]) {
+        _categoryIndexes = [NSMutableDictionary new];
+        _excludedCategory = category;
+        _capacity = MAX(capacity, 1);
+        _counts = calloc(_capacity, sizeof(NSUInteger));
+        _excluded = NSNotFound;
+        _leader = NSNotFound;
+        _runnerUp = NSNotFound;
+        _isCategorical = YES;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    free(_counts);
+}
+
+/**
+ * Whether category a ranks before category b: more votes, or as many but
+ * voted first
+ */
+- (BOOL)category:(NSUInteger)a ranksBefore:(NSUInteger)b {
+    
+    return (b == NSNotFound || _counts[a] > _counts[b] || (_counts[a] == _counts[b] && a < b));
+}
+
+- (void)addVote:(NSDictionary*)vote {
+    
+    id category = vote[@"prediction"];
+    //-- numeric predictions are averaged, not voted
+    if (!category || [category isKindOfClass:[NSNumber class]]) {
+        _isCategorical = NO;
+    }
+    if (!_isCategorical)
+        return;
+    
+    NSNumber* index = _categoryIndexes[category];
+    if (!index) {
+        if (_categoryCount == _capacity) {
+            _capacity *= 2;
+            _counts = realloc(_counts, _capacity * sizeof(NSUInteger));
+        }
+        if (_excludedCategory && [category isEqual:_excludedCategory]) {
+            _excluded = _categoryCount;
+        }
+        index = @(_categoryCount);
+        _counts[_categoryCount++] = 0;
+        _categoryIndexes[category] = index;
+    }
+    NSUInteger i = [index unsignedIntegerValue];
+    _counts[i]++;
+    _votes++;
+    
+    //-- only the voted category moves up, so it can only overtake the
+    //-- runner-up, or the leader, which then becomes the runner-up
+    if (i == _excluded || i == _leader)
+        return;
+    if ([self category:i ranksBefore:_leader]) {
+        _runnerUp = _leader;
+        _leader = i;
+    } else if (i != _runnerUp && [self category:i ranksBefore:_runnerUp]) {
+        _runnerUp = i;
+    }
+}
+
+/**
+ * The leader is decided if no other category, seen or not, can overtake
+ * it with the remaining votes. The best placed of the others is the
+ * runner-up, which wins a tie only if it was voted first.
+ */
+- (BOOL)isContestDecidedWithRemaining:(NSUInteger)remaining {
+    
+    //-- a category not seen yet would come after the leader in a tie
+    if (_leader == NSNotFound || remaining > _counts[_leader])
+        return NO;
+    if (_runnerUp == NSNotFound)
+        return YES;
+    
+    NSUInteger reachable = _counts[_runnerUp] + remaining;
+    return !(reachable > _counts[_leader] || (reachable == _counts[_leader] && _runnerUp < _leader));
+}
+
+- (BOOL)isDecidedWithRemaining:(NSUInteger)remaining {
+    
+    NSAssert(!_excludedCategory, @"PluralityTally isDecidedWithRemaining: contract unfulfilled");
+    return _isCategorical && [self isContestDecidedWithRemaining:remaining];
+}
+
+- (BOOL)isDecidedWithRemaining:(NSUInteger)remaining threshold:(NSUInteger)threshold {
+    
+    if (!_isCategorical)
+        return NO;
+    
+    NSUInteger categoryVotes = (_excluded == NSNotFound) ? 0 : _counts[_excluded];
+    if (categoryVotes >= threshold)
+        return YES;
+    
+    //-- once the category cannot reach the threshold, the rest is a plurality
+    return (categoryVotes + remaining < threshold &&
+            _votes >= threshold &&
+            [self isContestDecidedWithRemaining:remaining]);
+}
+
+@end
+
 @implementation PredictiveEnsemble {
     
     NSArray* _distributions;
     NSArray* _multiModels;
+    MultiModel* _members;
 }
 
 - (instancetype)initWithModels:(NSArray*)models
@@ -34,6 +182,7 @@
     if (self = [super init]) {
         
         _multiModels = [self multiModelsFromModels:models maxModels:maxModels];
+        _members = [self membersOfMultiModels:_multiModels];
         _isReadyToPredict = YES;
         _distributions = distributions;
     }
@@ -46,6 +195,10 @@
     return [self initWithModels:models maxModels:maxModels distributions:nil];
 }
 
+- (NSArray*)models {
+    return _members.models;
+}
+
 - (NSDictionary*)predictWithArguments:(NSDictionary*)inputData
                               options:(NSDictionary*)options {
     
@@ -62,26 +215,70 @@
     BOOL min = [options[@"min"] ?: @(NO) boolValue];
     BOOL max = [options[@"max"] ?: @(NO) boolValue];
     
+    BOOL parallel = [options[@"parallel"] ?: @(NO) boolValue];
+    NSUInteger threads = [options[@"threads"] ?: @(0) unsignedIntegerValue];
+    
+    BOOL earlyExit = [options[@"earlyExit"] ?: @(NO) boolValue] && !median &&
+        (method == ML4iOSPredictionMethodPlurality || method == ML4iOSPredictionMethodThreshold);
+    
     MultiVote* votes = [MultiVote new];
-    for (MultiModel* multiModel in _multiModels) {
-        MultiVote* partialVote = [multiModel generateVotes:inputData
-                                                    byName:byName
-                                           missingStrategy:missingStrategy
-                                                 median:median];
+    __block NSUInteger evaluated = 0;
+    if (earlyExit) {
+        //-- members vote one at a time until the winner cannot change
+        NSUInteger threshold = [options[@"threshold-k"] unsignedIntegerValue];
+        NSString* thresholdCategory = options[@"threshold-category"];
+        PluralityTally* tally =
+        [[PluralityTally alloc] initWithCapacity:_members.models.count
+                               excludingCategory:(method == ML4iOSPredictionMethodThreshold) ? thresholdCategory : nil];
+        votes = [_members generateVotes:inputData
+                                 byName:byName
+                        missingStrategy:missingStrategy
+                                 median:median
+                               stopWhen:^BOOL(NSDictionary* vote, NSUInteger remaining) {
+                                   evaluated++;
+                                   [tally addVote:vote];
+                                   if (method == ML4iOSPredictionMethodThreshold) {
+                                       return [tally isDecidedWithRemaining:remaining threshold:threshold];
+                                   }
+                                   return [tally isDecidedWithRemaining:remaining];
+                               }];
+    } else if (parallel) {
+        //-- all the members at once, in the same order as the serial loop below
+        votes = [_members generateVotes:inputData
+                                 byName:byName
+                        missingStrategy:missingStrategy
+                                 median:median
+                                threads:threads];
         if (median) {
-            [partialVote addMedian];
+            [votes addMedian];
+        }
+    } else {
+        for (MultiModel* multiModel in _multiModels) {
+            MultiVote* partialVote = [multiModel generateVotes:inputData
+                                                        byName:byName
+                                               missingStrategy:missingStrategy
+                                                        median:median];
+            if (median) {
+                [partialVote addMedian];
+            }
+            [votes extendWithMultiVote:partialVote];
         }
-        [votes extendWithMultiVote:partialVote];
     }
 
-    return [votes combineWithMethod:method
-                         confidence:confidence
-                    distribution:distribution
-                           count:count
-                          median:median
-                             min:min
-                             max:max
-                            options:options];
+    NSDictionary* result = [votes combineWithMethod:method
+                                         confidence:confidence
+                                       distribution:distribution
+                                              count:count
+                                             median:median
+                                                min:min
+                                                max:max
+                                            options:options];
+    if (earlyExit) {
+        NSMutableDictionary* earlyResult = [result mutableCopy];
+        earlyResult[@"skippedModels"] = @(_members.models.count - evaluated);
+        result = earlyResult;
+    }
+    return result;
 }
 
 + (NSDictionary*)predictWithJSONModels:(NSArray*)models
@@ -96,6 +293,18 @@
             options:options];
 }
 
+/**
+ * Groups the already built members of all the multi models in a single one
+ */
+- (MultiModel*)membersOfMultiModels:(NSArray*)multiModels {
+    
+    NSMutableArray* models = [NSMutableArray new];
+    for (MultiModel* multiModel in multiModels) {
+        [models addObjectsFromArray:multiModel.models];
+    }
+    return [MultiModel multiModelWithModels:models];
+}
+
 - (NSArray*)multiModelsFromModels:(NSArray*)models maxModels:(NSUInteger)maxModels {
     
     maxModels = maxModels ?: models.count;
@@ -106,8 +315,8 @@
         [multiModels addObject:
          [MultiModel multiModelWithModels:
           [models subarrayWithRange:(NSRange){
-             i * maxModels,
-             MIN(multiModelSize, models.count - i*multiModelSize)
+             i,
+             MIN(multiModelSize, models.count - i)
          }]]];
     }
     return multiModels;
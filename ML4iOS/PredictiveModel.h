@@ -37,6 +37,30 @@
  */
 @interface PredictiveModel : FieldResource
 
+/**
+ * The root of the model's decision tree
+ */
+@property (nonatomic, readonly) PredictionTree* tree;
+
+/**
+ * Initializes a local model from a BigML model resource, so that it can be
+ * used for any number of predictions. Predictions do not modify the model,
+ * so they can be made concurrently from several threads.
+ * @param jsonModel The model, as returned by BigML
+ */
+- (instancetype)initWithJSONModel:(NSDictionary*)jsonModel;
+
+/**
+ * Initializes a local model straight from the JSON bytes of a BigML model
+ * resource, e.g. mapped from a file. Only the parts of the resource used to
+ * predict are read (see JSONReader), so no full copy of the document is
+ * ever built: tree nodes are built as they are read, and their predicates
+ * prepared once the fields are known.
+ * @param data The UTF-8 JSON of the model
+ * @return nil if data is not valid JSON
+ */
+- (instancetype)initWithJSONData:(NSData*)data;
+
 /**
  * Makes a prediction based on a number of field values.
  *
@@ -68,11 +92,44 @@
  *  the maximum number of categories to be returned. If NSUIntegerMax,
  *  the entire distribution in the node will be returned.
  *
+ *        - path: When YES, each result also includes the list of rules
+ *                followed to reach the prediction, keyed with "path".
+ *                Defaults to NO, so that no rules are rendered.
+ *
  * This method will return an NSArray of TreePrediction objects.
  */
 - (NSArray*)predictWithArguments:(NSDictionary*)arguments
                          options:(NSDictionary*)options;
 
+/**
+ * Makes a prediction for each of the given rows.
+ *
+ * Options are parsed, and input keys are resolved to field indexes, once for
+ * the whole batch instead of once per row. Each row is bound into a single
+ * reused buffer of field values, without building an input dictionary.
+ *
+ * @param rows: An NSArray of input data dictionaries, keyed as for
+ *        predictWithArguments:options:
+ * @param options: The same options accepted by predictWithArguments:options:
+ * @return An NSArray holding, for each row, the NSArray that
+ *         predictWithArguments:options: would return
+ */
+- (NSArray*)predictBatch:(NSArray*)rows
+                 options:(NSDictionary*)options;
+
+/**
+ * Makes a prediction for each row of a columnar block of input data.
+ *
+ * @param columns: An NSDictionary mapping each field (by name or id, see
+ *        byName) to an NSArray with its values, one per row. Use NSNull
+ *        for missing values.
+ * @param options: The same options accepted by predictWithArguments:options:
+ * @return An NSArray holding, for each row, the NSArray that
+ *         predictWithArguments:options: would return
+ */
+- (NSArray*)predictBatchWithColumns:(NSDictionary*)columns
+                            options:(NSDictionary*)options;
+
 /**
  * Creates a local prediction using the model and args passed as parameters
  * @param jsonModel The model to use to create the prediction
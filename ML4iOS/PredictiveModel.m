@@ -13,26 +13,68 @@
 // under the License.
 
 #import "PredictiveModel.h"
+#import "CompiledTree.h"
 #import "TreePrediction.h"
 #import "Predicates.h"
 #import "ML4iOSUtils.h"
+#import "JSONReader.h"
 
 #define ML4iOS_DEFAULT_LOCALE @"en.US"
 
 @implementation PredictiveModel {
     
-    NSDictionary* fields;
     NSString* _description;
     NSMutableArray* _fieldImportance;
     PredictionTree* _tree;
+    CompiledTree* _compiledTree;
     NSMutableDictionary* _idsMap;
     NSInteger _maxBins;
-    
-    NSDictionary* _model;
 }
 
+@synthesize tree = _tree;
+
 - (instancetype)initWithJSONModel:(NSDictionary*)jsonModel {
     
+    NSDictionary* model = jsonModel[@"object"] ?: jsonModel;
+    NSDictionary* modelFields = model[@"model"][@"model_fields"];
+    
+    //-- only the top level of each field is modified below, so the caller's
+    //-- fields are copied one level deep
+    NSMutableDictionary* fields = [NSMutableDictionary dictionaryWithCapacity:modelFields.count];
+    for (NSString* fieldId in modelFields) {
+        [fields setObject:[modelFields[fieldId] mutableCopy] forKey:fieldId];
+    }
+    return [self initWithJSONModel:jsonModel modelFields:fields];
+}
+
+- (instancetype)initWithJSONData:(NSData*)data {
+    
+    //-- tree nodes are built as soon as they are read, children first, so no
+    //-- JSON graph of the tree is ever kept
+    static NSDictionary* specification = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        specification = [JSONReader modelSpecificationWithNodeBuilder:^id(NSMutableDictionary* node) {
+            return [[PredictionTree alloc] initWithNode:node children:node[@"children"] ?: @[]];
+        }];
+    });
+    NSDictionary* jsonModel = [JSONReader objectWithData:data
+                                                 keeping:specification
+                                                   error:nil];
+    if (![jsonModel isKindOfClass:[NSDictionary class]])
+        return nil;
+    
+    //-- the reader's containers are already mutable and not shared
+    NSDictionary* model = jsonModel[@"object"] ?: jsonModel;
+    return [self initWithJSONModel:jsonModel modelFields:model[@"model"][@"model_fields"]];
+}
+
+/**
+ * Builds the model taking ownership of its (mutable) model fields
+ */
+- (instancetype)initWithJSONModel:(NSDictionary*)jsonModel
+                      modelFields:(NSMutableDictionary*)modelFields {
+    
     NSString* locale;
     NSString* objectiveField;
     NSDictionary* model = jsonModel[@"object"] ?: jsonModel;
@@ -43,15 +85,13 @@
     if ([status[@"code"] intValue] != 5)
         return nil;
 
-    fields = CFBridgingRelease(CFPropertyListCreateDeepCopy(kCFAllocatorDefault,
-                                                            (CFDictionaryRef)model[@"model"][@"model_fields"],
-                                                            kCFPropertyListMutableContainers));
+    NSDictionary* fields = modelFields;
 
-    NSDictionary* modelFields = model[@"model"][@"fields"];
+    NSDictionary* resourceFields = model[@"model"][@"fields"];
     for (NSString* fieldName in fields.allKeys) {
         NSMutableDictionary* field = fields[fieldName];
         NSAssert(field, @"Missing field %@", fieldName);
-        NSDictionary* modelField = modelFields[fieldName];
+        NSDictionary* modelField = resourceFields[fieldName];
         [field setObject:modelField[@"summary"] forKey:@"summary"];
         [field setObject:modelField[@"name"] forKey:@"name"];
     }
@@ -70,9 +110,8 @@
                        missingTokens:nil]) {
         
         _maxBins = 0;
-        _model = model;
         _description = jsonModel[@"description"] ?: @"";
-        NSArray* modelFieldImportance = _model[@"model"][@"importance"];
+        NSArray* modelFieldImportance = model[@"model"][@"importance"];
         
         if (modelFieldImportance) {
             _fieldImportance = [NSMutableArray new];
@@ -84,18 +123,28 @@
         }
         
         _idsMap = [NSMutableDictionary new];
-        _tree = [[PredictionTree alloc] initWithRoot:_model[@"model"][@"root"]
-                                              fields:self.fields
-                                      objectiveField:objectiveField
-                                    rootDistribution:jsonModel[@"model"][@"distribution"][@"training"]
-                                            parentId:nil
-                                              idsMap:_idsMap
-                                             subtree:YES
-                                             maxBins:_maxBins];
+        id root = model[@"model"][@"root"];
+        if ([root isKindOfClass:[PredictionTree class]]) {
+            
+            //-- built by initWithJSONData: while reading, before the fields
+            //-- its predicates depend on were known
+            _tree = root;
+            [_tree finishWithFields:self.fields objectiveField:objectiveField idsMap:_idsMap];
+        } else {
+            _tree = [[PredictionTree alloc] initWithRoot:root
+                                                  fields:self.fields
+                                          objectiveField:objectiveField
+                                        rootDistribution:jsonModel[@"model"][@"distribution"][@"training"]
+                                                parentId:nil
+                                                  idsMap:_idsMap
+                                                 subtree:YES
+                                                 maxBins:_maxBins];
+        }
         
         if (_tree.isRegression) {
             _maxBins = _tree.maxBins;
         }
+        _compiledTree = [[CompiledTree alloc] initWithTree:_tree fields:self.fields schema:self.schema];
     }
     return self;
 }
@@ -104,39 +153,52 @@
     return floor(confidence * 10000.0) / 10000.0;
 }
 
-- (NSArray*)predictWithArguments:(NSDictionary*)arguments
-                         options:(NSDictionary*)options {
+- (TreePrediction*)predictionForInput:(NSDictionary*)inputData
+                             strategy:(MissingStrategy)strategy
+                             withPath:(BOOL)withPath {
     
-    BOOL byName = [options[@"byName"]?:@NO boolValue];
-    MissingStrategy strategy = [options[@"strategy"]?:@(MissingStrategyLastPrediction) intValue];
-    NSUInteger multiple = [options[@"multiple"]?:@0 intValue];
-    
-    NSAssert(arguments, @"Prediction arguments missing.");
-    NSMutableArray* output = [NSMutableArray new];
+    if (strategy == MissingStrategyLastPrediction) {
+        return [_compiledTree predict:inputData withPath:withPath];
+    }
+    return [_tree predict:inputData strategy:strategy withPath:withPath];
+}
+
+- (NSDictionary*)output:(NSDictionary*)output withPathOf:(TreePrediction*)prediction {
     
-    arguments = [ML4iOSUtils cast:[self filteredInputData:arguments byName:byName]
-                           fields:self.fields];
+    NSArray* path = prediction.path;
+    if (!path)
+        return output;
+    NSMutableDictionary* outputWithPath = [output mutableCopy];
+    [outputWithPath setObject:path forKey:@"path"];
+    return outputWithPath;
+}
+
+- (NSArray*)outputForPrediction:(TreePrediction*)prediction multiple:(NSUInteger)multiple {
     
-    TreePrediction* prediction = [_tree predict:arguments
-                                           path:nil
-                                       strategy:strategy];
+    NSMutableArray* output = [NSMutableArray new];
     NSArray* distribution = [prediction distribution];
-    NSDictionary* distributionDictionary = [ML4iOSUtils dictionaryFromDistributionArray:distribution];
+    NSDictionary* distributionDictionary = prediction.distributionDictionary ?:
+    [ML4iOSUtils dictionaryFromDistributionArray:distribution];
     long instances = prediction.count;
     if (multiple != 0 && ![_tree isRegression]) {
+        NSArray* confidences = prediction.categoryConfidences;
+        NSArray* probabilities = prediction.categoryProbabilities;
         for (NSInteger i = 0; i < MIN(distribution.count, multiple); ++i) {
             
             NSArray* distributionElement = distribution[i];
             id category = distributionElement.firstObject;
-            double confidence =
+            double confidence = confidences ? [confidences[i] doubleValue] :
             [ML4iOSUtils wsConfidence:category
                          distribution:distributionDictionary];
-            [output addObject:@{ @"prediction" : category,
-                                 @"confidence" : @([self roundedConfidence:confidence]),
-                                 @"probability" : @([distributionElement.lastObject doubleValue] / instances),
-                                 @"distribution" : distributionDictionary,
-                                 @"count" : @([distributionElement.lastObject longValue])
-                                 }];
+            double probability = probabilities ? [probabilities[i] doubleValue] :
+            [distributionElement.lastObject doubleValue] / instances;
+            [output addObject:[self output:@{ @"prediction" : category,
+                                              @"confidence" : @([self roundedConfidence:confidence]),
+                                              @"probability" : @(probability),
+                                              @"distribution" : distributionDictionary,
+                                              @"count" : @([distributionElement.lastObject longValue])
+                                              }
+                                withPathOf:prediction]];
         }
     } else {
         
@@ -146,15 +208,198 @@
             field = self.fieldNameById[field];
         }
         prediction.next = field;
-        [output addObject:@{ @"prediction" : prediction.prediction,
-                             @"confidence" : @([self roundedConfidence:prediction.confidence]),
-                             @"distribution" : distributionDictionary,
-                             @"count" : @(prediction.count)
-                             }];
+        [output addObject:[self output:@{ @"prediction" : prediction.prediction,
+                                          @"confidence" : @([self roundedConfidence:prediction.confidence]),
+                                          @"distribution" : distributionDictionary,
+                                          @"count" : @(prediction.count)
+                                          }
+                            withPathOf:prediction]];
     }
     return output;
 }
 
+- (NSArray*)predictWithArguments:(NSDictionary*)arguments
+                         options:(NSDictionary*)options {
+    
+    BOOL byName = [options[@"byName"]?:@NO boolValue];
+    MissingStrategy strategy = [options[@"strategy"]?:@(MissingStrategyLastPrediction) intValue];
+    NSUInteger multiple = [options[@"multiple"]?:@0 intValue];
+    BOOL withPath = [options[@"path"]?:@NO boolValue];
+    
+    NSAssert(arguments, @"Prediction arguments missing.");
+    
+    arguments = [ML4iOSUtils cast:[self filteredInputData:arguments byName:byName]
+                           fields:self.fields];
+    
+    return [self outputForPrediction:[self predictionForInput:arguments strategy:strategy withPath:withPath]
+                            multiple:multiple];
+}
+
+/**
+ * Resolves an input key (a field name or id) into the schema index of its
+ * field, or NSNotFound. Resolutions are stored in `cache` so that each
+ * distinct key is resolved once per batch.
+ */
+- (NSUInteger)indexForKey:(NSString*)key
+                   byName:(BOOL)byName
+                    cache:(NSMutableDictionary*)cache {
+    
+    NSNumber* index = cache[key];
+    if (!index) {
+        NSString* fieldId = byName ? self.fieldIdByName[key] : key;
+        index = @(fieldId ? [self.schema indexOfFieldId:fieldId] : NSNotFound);
+        [cache setObject:index forKey:key];
+    }
+    return [index unsignedIntegerValue];
+}
+
+/**
+ * Binds a single input value into the reused values buffer of a batch,
+ * applying the same normalization and casting that
+ * predictWithArguments:options: does. FieldValue does not retain its
+ * object, so the cast value is kept in `objects`, at the field's index.
+ */
+- (void)bindValue:(id)value
+          atIndex:(NSUInteger)index
+         toValues:(FieldValue*)values
+          objects:(NSMutableArray*)objects
+           fields:(NSArray*)fields {
+    
+    if (index == NSNotFound)
+        return;
+    value = [self normalizedValue:value];
+    if (!value || value == [NSNull null])
+        return;
+    value = [ML4iOSUtils castValue:value field:fields[index]];
+    [objects replaceObjectAtIndex:index withObject:value];
+    values[index] = FieldValueWithObject(value);
+}
+
+/**
+ * Predicts a row bound by bindValue:atIndex:toValues:objects:fields:. Only
+ * the proportional strategy, which walks the PredictionTree, needs the row
+ * as an input dictionary.
+ */
+- (TreePrediction*)predictionForValues:(const FieldValue*)values
+                              strategy:(MissingStrategy)strategy
+                              withPath:(BOOL)withPath {
+    
+    if (strategy == MissingStrategyLastPrediction) {
+        return [_compiledTree predictWithValues:values withPath:withPath];
+    }
+    NSArray* fieldIds = self.schema.fieldIds;
+    NSMutableDictionary* input = [NSMutableDictionary new];
+    for (NSUInteger i = 0; i < fieldIds.count; ++i) {
+        if (values[i].object) {
+            [input setObject:values[i].object forKey:fieldIds[i]];
+        }
+    }
+    return [_tree predict:input strategy:strategy withPath:withPath];
+}
+
+/**
+ * The fields in schema order, so that batches cast values by field index
+ */
+- (NSArray*)batchFieldsWithObjects:(NSMutableArray**)objects {
+    
+    NSArray* fieldIds = self.schema.fieldIds;
+    NSMutableArray* fields = [NSMutableArray arrayWithCapacity:fieldIds.count];
+    *objects = [NSMutableArray arrayWithCapacity:fieldIds.count];
+    for (NSString* fieldId in fieldIds) {
+        [fields addObject:self.fields[fieldId]];
+        [*objects addObject:[NSNull null]];
+    }
+    return fields;
+}
+
+- (NSArray*)predictBatch:(NSArray*)rows options:(NSDictionary*)options {
+    
+    BOOL byName = [options[@"byName"]?:@NO boolValue];
+    MissingStrategy strategy = [options[@"strategy"]?:@(MissingStrategyLastPrediction) intValue];
+    NSUInteger multiple = [options[@"multiple"]?:@0 intValue];
+    BOOL withPath = [options[@"path"]?:@NO boolValue];
+    
+    NSAssert(rows, @"Prediction rows missing.");
+    
+    NSUInteger count = self.schema.count;
+    NSMutableArray* objects = nil;
+    NSArray* fields = [self batchFieldsWithObjects:&objects];
+    NSMutableDictionary* indexes = [NSMutableDictionary new];
+    NSMutableArray* predictions = [NSMutableArray arrayWithCapacity:rows.count];
+    FieldValue* values = FieldValuesAlloc(count);
+    for (NSDictionary* row in rows) {
+        
+        for (NSUInteger i = 0; i < count; ++i) {
+            values[i] = (FieldValue){ nil, NAN, NO };
+        }
+        for (NSString* key in row) {
+            [self bindValue:row[key]
+                    atIndex:[self indexForKey:key byName:byName cache:indexes]
+                   toValues:values
+                    objects:objects
+                     fields:fields];
+        }
+        [predictions addObject:[self outputForPrediction:[self predictionForValues:values strategy:strategy withPath:withPath]
+                                                multiple:multiple]];
+    }
+    free(values);
+    return predictions;
+}
+
+- (NSArray*)predictBatchWithColumns:(NSDictionary*)columns options:(NSDictionary*)options {
+    
+    BOOL byName = [options[@"byName"]?:@NO boolValue];
+    MissingStrategy strategy = [options[@"strategy"]?:@(MissingStrategyLastPrediction) intValue];
+    NSUInteger multiple = [options[@"multiple"]?:@0 intValue];
+    BOOL withPath = [options[@"path"]?:@NO boolValue];
+    
+    NSAssert(columns, @"Prediction columns missing.");
+    
+    //-- resolve the columns to schema indexes once for the whole block
+    NSUInteger* columnIndexes = malloc(MAX(columns.count, 1) * sizeof(NSUInteger));
+    NSMutableArray* columnValues = [NSMutableArray arrayWithCapacity:columns.count];
+    NSMutableDictionary* indexes = [NSMutableDictionary new];
+    NSUInteger columnCount = 0;
+    NSUInteger rowCount = 0;
+    for (NSString* key in columns) {
+        NSUInteger index = [self indexForKey:key byName:byName cache:indexes];
+        NSArray* column = columns[key];
+        NSAssert([column isKindOfClass:[NSArray class]], @"Column %@ is not an array", key);
+        if (index != NSNotFound) {
+            columnIndexes[columnCount++] = index;
+            [columnValues addObject:column];
+            rowCount = MAX(rowCount, column.count);
+        }
+    }
+    
+    NSUInteger count = self.schema.count;
+    NSMutableArray* objects = nil;
+    NSArray* fields = [self batchFieldsWithObjects:&objects];
+    NSMutableArray* predictions = [NSMutableArray arrayWithCapacity:rowCount];
+    FieldValue* values = FieldValuesAlloc(count);
+    for (NSUInteger row = 0; row < rowCount; ++row) {
+        
+        for (NSUInteger i = 0; i < count; ++i) {
+            values[i] = (FieldValue){ nil, NAN, NO };
+        }
+        for (NSUInteger column = 0; column < columnCount; ++column) {
+            NSArray* rowValues = columnValues[column];
+            if (row < rowValues.count) {
+                [self bindValue:rowValues[row]
+                        atIndex:columnIndexes[column]
+                       toValues:values
+                        objects:objects
+                         fields:fields];
+            }
+        }
+        [predictions addObject:[self outputForPrediction:[self predictionForValues:values strategy:strategy withPath:withPath]
+                                                multiple:multiple]];
+    }
+    free(values);
+    free(columnIndexes);
+    return predictions;
+}
+
 + (NSDictionary*)predictWithJSONModel:(NSDictionary*)jsonModel
                             arguments:(NSDictionary*)inputData
                               options:(NSDictionary*)options {
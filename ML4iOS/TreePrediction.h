@@ -27,6 +27,15 @@
 @property (nonatomic, strong) NSString* distributionUnit;
 @property (nonatomic, strong) NSArray* children;
 
+/**
+ * Precomputed outputs of the node the prediction stopped at (see
+ * PredictionTree). They are nil when the prediction does not come
+ * from a single node, e.g. for merged proportional distributions.
+ */
+@property (nonatomic, strong) NSDictionary* distributionDictionary;
+@property (nonatomic, strong) NSArray* categoryConfidences;
+@property (nonatomic, strong) NSArray* categoryProbabilities;
+
 + (TreePrediction*)treePrediction:(id)prediction
                        confidence:(double)confidence
                             count:(long)count
@@ -36,4 +45,15 @@
                  distributionUnit:(NSString*)distributionUnit
                          children:(NSArray*)children;
 
+/**
+ * Sets the decision path as the list of predicates followed by the
+ * prediction. Their rules are only rendered when path is first read.
+ * @param predicates The Predicate objects along the path
+ * @param fields The fields of the predictive model
+ * @param uniqueRules Whether repeated rules must be dropped from the path
+ */
+- (void)setPathPredicates:(NSArray*)predicates
+                   fields:(NSDictionary*)fields
+              uniqueRules:(BOOL)uniqueRules;
+
 @end
@@ -13,8 +13,16 @@
 // under the License.
 
 #import "TreePrediction.h"
+#import "Predicates.h"
 
-@implementation TreePrediction
+@implementation TreePrediction {
+    
+    NSArray* _pathPredicates;
+    NSDictionary* _pathFields;
+    BOOL _uniquePathRules;
+}
+
+@synthesize path = _path;
 
 + (TreePrediction*)treePrediction:(id)prediction
                        confidence:(double)confidence
@@ -38,4 +46,38 @@
     return p;
 }
 
+- (void)setPathPredicates:(NSArray*)predicates
+                   fields:(NSDictionary*)fields
+              uniqueRules:(BOOL)uniqueRules {
+    
+    _path = nil;
+    _pathPredicates = predicates;
+    _pathFields = fields;
+    _uniquePathRules = uniqueRules;
+}
+
+- (void)setPath:(NSArray*)path {
+    
+    _path = path;
+    _pathPredicates = nil;
+    _pathFields = nil;
+}
+
+- (NSArray*)path {
+    
+    if (!_path && _pathPredicates) {
+        NSMutableArray* rules = [NSMutableArray arrayWithCapacity:_pathPredicates.count];
+        for (Predicate* predicate in _pathPredicates) {
+            NSString* rule = [predicate ruleWithFields:_pathFields label:nil];
+            if (!_uniquePathRules || ![rules containsObject:rule]) {
+                [rules addObject:rule];
+            }
+        }
+        _path = rules;
+        _pathPredicates = nil;
+        _pathFields = nil;
+    }
+    return _path;
+}
+
 @end
@@ -110,6 +110,24 @@
                                          arguments:(NSDictionary*)args
                                            options:(NSDictionary*)options;
 
+/**
+ * Computes local centroids for many rows using the cluster passed as
+ * parameter. The cluster is loaded once and the rows are assigned in parallel.
+ * @param jsonCluster The cluster to use to create the predictions
+ * @param rows The arguments of each row
+ * @param options A dictionary of options that will affect the prediction.
+ This is a list of allowed options:
+ - byName: set to YES when specifying arguments by their names
+ (vs. field IDs)
+ - threads: maximum number of concurrent workers (0, the default, uses one
+ per active processor)
+ * @return One result per row, in order, as localCentroidsWithJSONClusterSync:
+ would return it
+ */
++ (NSArray*)localCentroidsWithJSONClusterSync:(NSDictionary*)jsonCluster
+                                         rows:(NSArray*)rows
+                                      options:(NSDictionary*)options;
+
 /**
  * Computes local score using the anomaly and args passed as parameters
  * @param jsonAnomaly The anomaly to use to calculate the score
@@ -124,4 +142,23 @@
                               arguments:(NSDictionary*)args
                                 options:(NSDictionary*)options;
 
+/**
+ * Computes local scores for many rows using the anomaly passed as parameter.
+ * The anomaly is loaded once and the rows are scored in parallel.
+ * @param jsonAnomaly The anomaly to use to calculate the scores
+ * @param rows The arguments of each row to score
+ * @param options A dictionary of options that will affect the scoring.
+ This is a list of allowed options:
+ - byName: set to YES when specifying arguments by their names
+ (vs. field IDs)
+ - threads: maximum number of concurrent workers (0, the default, uses one
+ per active processor)
+ - threshold: only return the rows whose score is at least this value
+ * @return One dictionary per returned row, with its "index" in rows, its
+ "score" and its "meanDepth"
+ */
++ (NSArray*)localScoresWithJSONAnomalySync:(NSDictionary*)jsonAnomaly
+                                      rows:(NSArray*)rows
+                                   options:(NSDictionary*)options;
+
 @end
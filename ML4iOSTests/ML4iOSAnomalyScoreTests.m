@@ -11,6 +11,8 @@
 #import "ML4iOSEnums.h"
 #import "ML4iOSLocalPredictions.h"
 #import "ML4iOSTestCase.h"
+#import "Anomaly.h"
+#import "ModelArchive.h"
 
 @interface ML4iOSAnomalyScoreTests : ML4iOSTestCase
 
@@ -41,6 +43,166 @@
     XCTAssert([self.apiLibrary compareFloat:score float:0.699], @"Pass");
 }
 
+- (void)testStoredAnomalyConcurrentScores {
+    
+    Anomaly* anomaly = [[Anomaly alloc] initWithJSONAnomaly:[self storedResourceNamed:@"testAnomaly" ofType:@"json"]];
+    XCTAssert(anomaly.treeCount > 0);
+    
+    NSDictionary* input = @{ @"sepal length": @(6.02),
+                             @"sepal width": @(3.15),
+                             @"petal width": @(1.51),
+                             @"petal length": @(4.07) };
+    double expected = [anomaly score:input options:@{ @"byName": @YES }];
+    XCTAssert([self.apiLibrary compareFloat:expected float:0.699]);
+    
+    //-- the compiled forest is only read while scoring
+    size_t iterations = 64;
+    double* scores = calloc(iterations, sizeof(double));
+    dispatch_apply(iterations, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        scores[i] = [anomaly score:input options:@{ @"byName": @YES }];
+    });
+    for (size_t i = 0; i < iterations; ++i) {
+        XCTAssertEqual(scores[i], expected);
+    }
+    free(scores);
+}
+
+- (void)testStoredAnomalyBatchScores {
+    
+    Anomaly* anomaly = [[Anomaly alloc] initWithJSONAnomaly:[self storedResourceNamed:@"testAnomaly" ofType:@"json"]];
+    
+    NSDictionary* typical = @{ @"sepal length": @(6.02),
+                               @"sepal width": @(3.15),
+                               @"petal width": @(1.51),
+                               @"petal length": @(4.07) };
+    NSDictionary* unusual = @{ @"sepal length": @(9.5),
+                               @"sepal width": @(0.5),
+                               @"petal width": @(4.0),
+                               @"petal length": @(0.1) };
+    NSMutableArray* rows = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 100; ++i) {
+        [rows addObject:(i % 10 == 3) ? unusual : typical];
+    }
+    
+    NSArray* scores = [anomaly scores:rows options:@{ @"byName": @YES }];
+    XCTAssertEqual(scores.count, rows.count);
+    for (NSUInteger i = 0; i < rows.count; ++i) {
+        XCTAssertEqual([scores[i][@"index"] unsignedIntegerValue], i);
+        XCTAssertEqual([scores[i][@"score"] doubleValue],
+                       [anomaly score:rows[i] options:@{ @"byName": @YES }]);
+    }
+    
+    //-- only the unusual rows clear a threshold between both scores
+    double typicalScore = [scores[0][@"score"] doubleValue];
+    double unusualScore = [scores[3][@"score"] doubleValue];
+    XCTAssert(unusualScore > typicalScore);
+    NSArray* flagged = [anomaly scores:rows
+                               options:@{ @"byName": @YES,
+                                          @"threshold": @((typicalScore + unusualScore) / 2) }];
+    XCTAssertEqual(flagged.count, 10);
+    for (NSDictionary* row in flagged) {
+        XCTAssertEqual([row[@"index"] unsignedIntegerValue] % 10, 3);
+        XCTAssert([row[@"meanDepth"] doubleValue] > 0);
+    }
+}
+
+- (void)testStoredAnomalyPaths {
+    
+    Anomaly* anomaly = [[Anomaly alloc] initWithJSONAnomaly:[self storedResourceNamed:@"testAnomaly" ofType:@"json"]];
+    
+    NSDictionary* input = @{ @"sepal length": @(6.02),
+                             @"sepal width": @(3.15),
+                             @"petal width": @(1.51),
+                             @"petal length": @(4.07) };
+    NSArray* paths = [anomaly pathsForInput:input options:@{ @"byName": @YES }];
+    XCTAssertEqual(paths.count, anomaly.treeCount);
+    
+    //-- each rule below the root adds one to the depth of its tree
+    double depthSum = 0;
+    for (NSArray* rules in paths) {
+        depthSum += rules.count + 1;
+        for (NSString* rule in rules) {
+            XCTAssert(rule.length > 0);
+        }
+    }
+    NSDictionary* scored = [anomaly scores:@[input] options:@{ @"byName": @YES }].firstObject;
+    XCTAssertEqualWithAccuracy([scored[@"meanDepth"] doubleValue], depthSum / paths.count, 1e-9);
+}
+
+- (void)testStoredAnomalyThreshold {
+    
+    Anomaly* anomaly = [[Anomaly alloc] initWithJSONAnomaly:[self storedResourceNamed:@"testAnomaly" ofType:@"json"]];
+    
+    NSDictionary* input = @{ @"sepal length": @(6.02),
+                             @"sepal width": @(3.15),
+                             @"petal width": @(1.51),
+                             @"petal length": @(4.07) };
+    double score = [anomaly score:input options:@{ @"byName": @YES }];
+    
+    for (NSNumber* threshold in @[@0.0, @0.3, @0.6, @(score), @0.8, @0.99]) {
+        NSUInteger evaluated = 0;
+        BOOL anomalous = [anomaly isAnomalous:input
+                                    threshold:threshold.doubleValue
+                                      options:@{ @"byName": @YES }
+                               treesEvaluated:&evaluated];
+        XCTAssertEqual(anomalous, score >= threshold.doubleValue);
+        XCTAssert(evaluated > 0 && evaluated <= anomaly.treeCount);
+    }
+    
+    //-- thresholds far from the score are settled by the first trees
+    NSUInteger evaluated = 0;
+    XCTAssert([anomaly isAnomalous:input threshold:0.0 options:@{ @"byName": @YES } treesEvaluated:&evaluated]);
+    XCTAssertEqual(evaluated, 1);
+    XCTAssertFalse([anomaly isAnomalous:input threshold:0.99 options:@{ @"byName": @YES } treesEvaluated:&evaluated]);
+    XCTAssert(evaluated < anomaly.treeCount);
+}
+
+- (void)testStoredAnomalyArchive {
+    
+    Anomaly* anomaly = [[Anomaly alloc] initWithJSONAnomaly:[self storedResourceNamed:@"testAnomaly" ofType:@"json"]];
+    
+    NSError* error = nil;
+    NSString* archivePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"anomaly.ml4b"];
+    XCTAssert([anomaly writeToFile:archivePath error:&error]);
+    Anomaly* archived = [[Anomaly alloc] initWithContentsOfFile:archivePath error:&error];
+    XCTAssert(archived && !error);
+    XCTAssertEqual(archived.treeCount, anomaly.treeCount);
+    XCTAssertEqual(archived.nodeCount, anomaly.nodeCount);
+    
+    NSArray* rows = @[ @{ @"sepal length": @(6.02), @"sepal width": @(3.15),
+                          @"petal width": @(1.51), @"petal length": @(4.07) },
+                       @{ @"sepal length": @(7.9), @"sepal width": @(2.0),
+                          @"petal width": @(0.1), @"petal length": @(6.9) },
+                       @{ @"petal length": @(1.4) },
+                       @{} ];
+    NSDictionary* options = @{ @"byName": @YES };
+    for (NSDictionary* row in rows) {
+        XCTAssertEqual([archived score:row options:options], [anomaly score:row options:options]);
+        XCTAssertEqualObjects([archived pathsForInput:row options:options],
+                              [anomaly pathsForInput:row options:options]);
+    }
+    XCTAssertEqualObjects([archived scores:rows options:@{ @"byName": @YES, @"threshold": @0.6 }],
+                          [anomaly scores:rows options:@{ @"byName": @YES, @"threshold": @0.6 }]);
+    
+    //-- a forest is not a tree archive, and a broken split is rejected
+    XCTAssertNil([[ModelArchive alloc] initWithContentsOfFile:archivePath error:&error]);
+    XCTAssertEqual(error.code, ModelArchiveErrorInvalidFormat);
+    
+    NSMutableData* corrupted = [NSMutableData dataWithContentsOfFile:archivePath];
+    NSUInteger splits = (NSUInteger)((const ModelArchiveHeader*)corrupted.bytes)->splits.offset;
+    uint32_t field = MODEL_ARCHIVE_NONE - 1;
+    uint8_t numeric = 1;
+    [corrupted replaceBytesInRange:(NSRange){ splits + offsetof(ModelArchiveSplit, field), sizeof(field) }
+                         withBytes:&field];
+    [corrupted replaceBytesInRange:(NSRange){ splits + offsetof(ModelArchiveSplit, numeric), sizeof(numeric) }
+                         withBytes:&numeric];
+    [corrupted writeToFile:archivePath atomically:YES];
+    error = nil;
+    XCTAssertNil([[Anomaly alloc] initWithContentsOfFile:archivePath error:&error]);
+    XCTAssertEqual(error.code, ModelArchiveErrorInvalidFormat);
+    [[NSFileManager defaultManager] removeItemAtPath:archivePath error:nil];
+}
+
 - (void)testWinesAnomalyScore {
     
     self.apiLibrary.csvFileName = @"wines.csv";
@@ -14,6 +14,7 @@
 
 #import <XCTest/XCTest.h>
 #import "PredictiveCluster.h"
+#import "PredictionCentroid.h"
 #import "ML4iOSTestCase.h"
 #import "ML4iOSTester.h"
 
@@ -83,6 +84,207 @@
     XCTAssert(prediction, @"Pass");
 }
 
+- (void)testStoredClusterNearestCentroid {
+    
+    NSMutableDictionary* cluster = [self storedResourceNamed:@"testCluster" ofType:@"json"];
+    NSDictionary* fields = cluster[@"clusters"][@"fields"];
+    NSDictionary* scales = cluster[@"scales"];
+    
+    NSArray* inputs = @[ @{ @"sepal length": @5.0, @"sepal width": @3.4,
+                            @"petal length": @1.5, @"petal width": @0.2,
+                            @"species": @"Iris-setosa" },
+                         @{ @"sepal length": @6.4, @"sepal width": @2.9,
+                            @"petal length": @4.6, @"petal width": @1.4,
+                            @"species": @"Iris-versicolor" },
+                         @{ @"sepal length": @7.7, @"sepal width": @3.0,
+                            @"petal length": @6.1, @"petal width": @2.3,
+                            @"species": @"Iris-setosa" } ];
+    for (NSDictionary* input in inputs) {
+        
+        //-- brute force over the centers, field by field
+        NSString* expectedName = nil;
+        double expectedDistance2 = INFINITY;
+        for (NSDictionary* centroid in cluster[@"clusters"][@"clusters"]) {
+            double distance2 = 0;
+            for (NSString* fieldId in centroid[@"center"]) {
+                id center = centroid[@"center"][fieldId];
+                id value = input[fields[fieldId][@"name"]];
+                double scale = [scales[fieldId] doubleValue];
+                if ([center isKindOfClass:[NSString class]]) {
+                    distance2 += [center isEqual:value] ? 0 : scale * scale;
+                } else {
+                    distance2 += pow(([value doubleValue] - [center doubleValue]) * scale, 2);
+                }
+            }
+            if (distance2 < expectedDistance2) {
+                expectedDistance2 = distance2;
+                expectedName = centroid[@"name"];
+            }
+        }
+        
+        NSDictionary* prediction = [PredictiveCluster predictWithJSONCluster:cluster
+                                                                   arguments:input
+                                                                     options:@{ @"byName" : @YES }];
+        XCTAssertEqualObjects(prediction[@"centroidName"], expectedName);
+        XCTAssertEqualWithAccuracy([prediction[@"distance"] doubleValue], sqrt(expectedDistance2), 1e-4);
+    }
+}
+
+- (void)testStoredClusterBatchNearestCentroids {
+    
+    NSMutableDictionary* cluster = [self storedResourceNamed:@"testCluster" ofType:@"json"];
+    
+    NSArray* species = @[@"Iris-setosa", @"Iris-versicolor", @"Iris-virginica"];
+    NSMutableArray* rows = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 300; ++i) {
+        [rows addObject:@{ @"sepal length": @(4.3 + (i % 37) * 0.1),
+                           @"sepal width": @(2.0 + (i % 23) * 0.1),
+                           @"petal length": @(1.0 + (i % 59) * 0.1),
+                           @"petal width": @(0.1 + (i % 25) * 0.1),
+                           @"species": species[i % 3] }];
+    }
+    
+    PredictiveCluster* localCluster = [[PredictiveCluster alloc] initWithCluster:cluster];
+    NSArray* serial = [localCluster computeNearestForRows:rows options:@{ @"byName" : @YES, @"threads" : @1 }];
+    NSArray* parallel = [localCluster computeNearestForRows:rows options:@{ @"byName" : @YES }];
+    XCTAssertEqual(serial.count, rows.count);
+    XCTAssertEqualObjects(serial, parallel);
+    for (NSUInteger i = 0; i < rows.count; ++i) {
+        NSDictionary* prediction = [PredictiveCluster predictWithJSONCluster:cluster
+                                                                   arguments:rows[i]
+                                                                     options:@{ @"byName" : @YES }];
+        XCTAssertEqualObjects(serial[i], prediction);
+    }
+}
+
+- (void)testStoredClusterNearestCentroidsAndDistances {
+    
+    NSMutableDictionary* cluster = [self storedResourceNamed:@"testCluster" ofType:@"json"];
+    NSDictionary* input = @{ @"sepal length": @6.4, @"sepal width": @2.9,
+                             @"petal length": @4.6, @"petal width": @1.4,
+                             @"species": @"Iris-versicolor" };
+    
+    PredictiveCluster* localCluster = [[PredictiveCluster alloc] initWithCluster:cluster];
+    NSUInteger centroidCount = localCluster.centroids.count;
+    double distances[centroidCount];
+    [localCluster distancesToInput:input options:@{ @"byName" : @YES } into:distances];
+    
+    NSUInteger indexes[centroidCount + 2];
+    double nearestDistances[centroidCount + 2];
+    NSUInteger count = [localCluster nearestCentroids:3
+                                              toInput:input
+                                              options:@{ @"byName" : @YES }
+                                              indexes:indexes
+                                            distances:nearestDistances];
+    XCTAssertEqual(count, 3);
+    
+    //-- the nearest centroids are those with the least distances, in order
+    for (NSUInteger i = 0; i < count; ++i) {
+        XCTAssertEqual(nearestDistances[i], distances[indexes[i]]);
+        if (i > 0)
+            XCTAssert(nearestDistances[i - 1] <= nearestDistances[i]);
+    }
+    for (NSUInteger c = 0; c < centroidCount; ++c) {
+        if (c != indexes[0] && c != indexes[1] && c != indexes[2])
+            XCTAssert(distances[c] >= nearestDistances[2]);
+    }
+    
+    NSDictionary* prediction = [PredictiveCluster predictWithJSONCluster:cluster
+                                                               arguments:input
+                                                                 options:@{ @"byName" : @YES }];
+    XCTAssertEqualObjects(prediction[@"centroidName"], [localCluster.centroids[indexes[0]] name]);
+    XCTAssertEqualWithAccuracy([prediction[@"distance"] doubleValue], nearestDistances[0], 1e-4);
+    
+    //-- asking for more centroids than there are returns them all
+    count = [localCluster nearestCentroids:centroidCount + 2
+                                   toInput:input
+                                   options:@{ @"byName" : @YES }
+                                   indexes:indexes
+                                 distances:nearestDistances];
+    XCTAssertEqual(count, centroidCount);
+}
+
+- (void)testStoredTextClusterCosineDistance {
+    
+    NSMutableDictionary* cluster = [self storedResourceNamed:@"spam-text" ofType:@"cluster"];
+    NSArray* centroids = cluster[@"clusters"][@"clusters"];
+    
+    //-- the stored cluster has no summaries, so build a tag cloud from the centers
+    NSMutableOrderedSet* tags = [NSMutableOrderedSet orderedSet];
+    for (NSDictionary* centroid in centroids) {
+        [tags addObjectsFromArray:centroid[@"center"][@"000001"]];
+    }
+    NSMutableArray* tagCloud = [NSMutableArray array];
+    for (NSString* tag in tags) {
+        [tagCloud addObject:@[tag, @1]];
+    }
+    cluster[@"clusters"][@"fields"][@"000001"][@"summary"] = @{ @"tag_cloud": tagCloud,
+                                                                @"term_forms": @{} };
+    
+    NSString* message = @"oh you call me to your place";
+    NSMutableSet* inputTerms = [NSMutableSet set];
+    for (NSString* word in [message componentsSeparatedByString:@" "]) {
+        if ([tags containsObject:word])
+            [inputTerms addObject:word];
+    }
+    XCTAssert(inputTerms.count > 0);
+    
+    NSString* expectedName = nil;
+    double expectedDistance2 = INFINITY;
+    for (NSDictionary* centroid in centroids) {
+        double distance2 = [centroid[@"center"][@"000000"] isEqual:@"ham"] ? 0 : 0.25;
+        NSArray* terms = centroid[@"center"][@"000001"];
+        if (terms.count == 0) {
+            distance2 += 0.25;
+        } else {
+            NSUInteger shared = 0;
+            for (NSString* term in terms) {
+                shared += [inputTerms containsObject:term] ? 1 : 0;
+            }
+            double similarity = shared / sqrt((double)inputTerms.count * terms.count);
+            distance2 += pow(0.5 * (1 - similarity), 2);
+        }
+        if (distance2 < expectedDistance2) {
+            expectedDistance2 = distance2;
+            expectedName = centroid[@"name"];
+        }
+    }
+    
+    NSDictionary* prediction = [PredictiveCluster predictWithJSONCluster:cluster
+                                                               arguments:@{ @"Type": @"ham",
+                                                                            @"Message": message }
+                                                                 options:@{ @"byName" : @YES }];
+    XCTAssertEqualObjects(prediction[@"centroidName"], expectedName);
+    XCTAssertEqualWithAccuracy([prediction[@"distance"] doubleValue], sqrt(expectedDistance2), 1e-4);
+}
+
+- (void)testStoredTextClusterTermAnalysis {
+    
+    NSMutableDictionary* cluster = [self storedResourceNamed:@"spam-text" ofType:@"cluster"];
+    NSMutableDictionary* field = cluster[@"clusters"][@"fields"][@"000001"];
+    field[@"summary"] = @{ @"tag_cloud": @[@[@"call", @10], @[@"you", @8], @[@"free", @5]],
+                           @"term_forms": @{ @"call": @[@"calling", @"called"] } };
+    
+    NSDictionary*(^predict)(NSString*) = ^NSDictionary*(NSString* message) {
+        return [PredictiveCluster predictWithJSONCluster:cluster
+                                               arguments:@{ @"Type": @"spam", @"Message": message }
+                                                 options:@{ @"byName" : @YES }];
+    };
+    
+    //-- forms are reduced to their term, case insensitively
+    NSDictionary* byTerm = predict(@"call you");
+    NSDictionary* byForm = predict(@"Calling YOU");
+    XCTAssertEqualObjects(byForm[@"centroidName"], byTerm[@"centroidName"]);
+    XCTAssertEqualWithAccuracy([byForm[@"distance"] doubleValue], [byTerm[@"distance"] doubleValue], 1e-6);
+    
+    //-- only the whole text is a term when the field keeps full terms only
+    NSDictionary* noTerms = predict(@"nothing here");
+    field[@"term_analysis"][@"token_mode"] = @"full_terms_only";
+    NSDictionary* fullTerms = predict(@"call you");
+    XCTAssertEqualObjects(fullTerms[@"centroidName"], noTerms[@"centroidName"]);
+    XCTAssertEqualWithAccuracy([fullTerms[@"distance"] doubleValue], [noTerms[@"distance"] doubleValue], 1e-6);
+}
+
 - (void)testPerformanceExample {
     // This is an example of a performance test case.
     [self measureBlock:^{
@@ -14,6 +14,9 @@
 
 #import <XCTest/XCTest.h>
 #import "ML4iOSLocalPredictions.h"
+#import "PredictiveEnsemble.h"
+#import "MultiVote.h"
+#import "ModelArchive.h"
 #import "ML4iOSTester.h"
 #import "ML4iOSEnums.h"
 #import "ML4iOSTestCase.h"
@@ -61,6 +64,206 @@
     return prediction;
 }
 
+/**
+ * The stored iris model with its tree replaced by a single pure leaf, so
+ * that ensembles can be built from members that vote as needed
+ */
+- (NSDictionary*)irisModelVoting:(NSString*)category count:(NSUInteger)count {
+    
+    NSMutableDictionary* model = [self storedResourceNamed:@"iris" ofType:@"model"];
+    NSMutableDictionary* resource = model[@"object"] ?: model;
+    
+    //-- the Wilson score of a leaf holding a single category
+    double confidence = count / (count + 1.96 * 1.96);
+    resource[@"model"][@"root"] = @{ @"id" : @0,
+                                     @"output" : category,
+                                     @"confidence" : @(confidence),
+                                     @"count" : @(count),
+                                     @"distribution" : @[ @[ category, @(count) ] ],
+                                     @"predicate" : @YES };
+    return model;
+}
+
+- (void)testStoredIrisModelsPrebuiltEnsemble {
+    
+    //-- two weak versicolor votes against a confident setosa one
+    NSArray* models = @[ [self irisModelVoting:@"Iris-setosa" count:50],
+                         [self irisModelVoting:@"Iris-versicolor" count:3],
+                         [self irisModelVoting:@"Iris-versicolor" count:2] ];
+    PredictiveEnsemble* ensemble = [[PredictiveEnsemble alloc] initWithModels:models
+                                                                    maxModels:2
+                                                                distributions:nil];
+    NSDictionary* arguments = @{ @"sepal width": @3.15, @"petal length": @4.07, @"petal width": @1.51 };
+    NSDictionary* winners = @{ @(ML4iOSPredictionMethodPlurality) : @"Iris-versicolor",
+                               @(ML4iOSPredictionMethodConfidence) : @"Iris-setosa",
+                               @(ML4iOSPredictionMethodProbability) : @"Iris-versicolor" };
+    for (NSNumber* method in winners) {
+        
+        NSDictionary* options = @{ @"byName" : @YES, @"method" : method };
+        NSDictionary* prediction = [ensemble predictWithArguments:arguments options:options];
+        XCTAssertEqualObjects(prediction[@"prediction"], winners[method]);
+        
+        NSDictionary* expected = [PredictiveEnsemble predictWithJSONModels:models
+                                                                      args:arguments
+                                                                   options:options
+                                                             distributions:nil];
+        XCTAssert([prediction isEqualToDictionary:expected]);
+        
+        NSMutableDictionary* parallelOptions = [options mutableCopy];
+        [parallelOptions addEntriesFromDictionary:@{ @"parallel" : @YES, @"threads" : @2 }];
+        XCTAssert([[ensemble predictWithArguments:arguments options:parallelOptions] isEqualToDictionary:expected]);
+    }
+    
+    //-- ties go to the category voted first, also when members vote in parallel
+    for (NSArray* categories in @[ @[ @"Iris-virginica", @"Iris-versicolor" ],
+                                   @[ @"Iris-versicolor", @"Iris-virginica" ] ]) {
+        
+        PredictiveEnsemble* tied =
+        [[PredictiveEnsemble alloc] initWithModels:@[ [self irisModelVoting:categories[0] count:5],
+                                                      [self irisModelVoting:categories[1] count:5] ]
+                                         maxModels:1
+                                     distributions:nil];
+        for (NSDictionary* options in @[ @{ @"byName" : @YES },
+                                         @{ @"byName" : @YES, @"parallel" : @YES, @"threads" : @2 } ]) {
+            XCTAssertEqualObjects([tied predictWithArguments:arguments options:options][@"prediction"],
+                                  categories[0]);
+        }
+    }
+}
+
+- (void)testStoredIrisModelsEarlyExitEnsemble {
+    
+    NSString* setosa = @"Iris-setosa";
+    NSString* versicolor = @"Iris-versicolor";
+    NSString* virginica = @"Iris-virginica";
+    NSDictionary* thresholdOptions = @{ @"method" : @(ML4iOSPredictionMethodThreshold),
+                                        @"threshold-k" : @2,
+                                        @"threshold-category" : versicolor };
+    NSDictionary* unreachedOptions = @{ @"method" : @(ML4iOSPredictionMethodThreshold),
+                                        @"threshold-k" : @3,
+                                        @"threshold-category" : virginica };
+    
+    //-- member votes, options, winner and the number of members skipped
+    NSArray* cases =
+    @[ //-- mixed votes, decided as soon as the leader cannot be caught
+       @[ @[ setosa, setosa, versicolor, setosa, virginica ], @{}, setosa, @1 ],
+       //-- a tie goes to the category voted first, so every member votes
+       @[ @[ versicolor, setosa, setosa, versicolor ], @{}, versicolor, @0 ],
+       //-- a category not voted yet could at most tie with the leader, and lose
+       @[ @[ setosa, setosa, virginica, virginica ], @{}, setosa, @2 ],
+       //-- the threshold category reaches threshold-k, outvoted or not
+       @[ @[ versicolor, setosa, versicolor, setosa, setosa ], thresholdOptions, versicolor, @2 ],
+       //-- it can no longer reach it, so the rest of the votes is a plurality
+       @[ @[ setosa, versicolor, setosa, setosa, versicolor ], unreachedOptions, setosa, @1 ] ];
+    
+    NSDictionary* arguments = @{ @"sepal width": @3.15, @"petal length": @4.07, @"petal width": @1.51 };
+    for (NSArray* testCase in cases) {
+        
+        NSMutableArray* models = [NSMutableArray array];
+        for (NSString* category in testCase[0]) {
+            [models addObject:[self irisModelVoting:category count:10]];
+        }
+        PredictiveEnsemble* ensemble = [[PredictiveEnsemble alloc] initWithModels:models
+                                                                        maxModels:0
+                                                                    distributions:nil];
+        NSMutableDictionary* options = [@{ @"byName" : @YES,
+                                           @"method" : @(ML4iOSPredictionMethodPlurality) } mutableCopy];
+        [options addEntriesFromDictionary:testCase[1]];
+        NSDictionary* expected = [ensemble predictWithArguments:arguments options:options];
+        XCTAssertEqualObjects(expected[@"prediction"], testCase[2]);
+        
+        options[@"earlyExit"] = @YES;
+        NSDictionary* prediction = [ensemble predictWithArguments:arguments options:options];
+        XCTAssertEqualObjects(prediction[@"prediction"], testCase[2]);
+        XCTAssertEqualObjects(prediction[@"skippedModels"], testCase[3]);
+    }
+}
+
+- (void)testStoredIrisModelsArchivedEnsemble {
+
+    //-- members of different sizes that disagree, so that each tree must be
+    //-- walked from its own nodes and entries
+    NSDictionary* model = [self storedResourceNamed:@"iris" ofType:@"model"];
+    NSArray* models = @[ [self irisModelVoting:@"Iris-virginica" count:4],
+                         model,
+                         [self irisModelVoting:@"Iris-setosa" count:50],
+                         [self irisModelVoting:@"Iris-virginica" count:3] ];
+    PredictiveEnsemble* ensemble = [[PredictiveEnsemble alloc] initWithModels:models
+                                                                    maxModels:0
+                                                                distributions:nil];
+
+    NSString* path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"iris-ensemble.ml4b"];
+    XCTAssert([ModelArchive writeModels:ensemble.models toFile:path error:nil]);
+    ModelArchive* archive = [[ModelArchive alloc] initWithContentsOfFile:path error:nil];
+    XCTAssert(archive.treeCount == models.count);
+
+    for (NSDictionary* arguments in @[ @{ @"sepal width": @3.15, @"petal length": @4.07, @"petal width": @1.51 },
+                                       @{ @"petal length": @1.2 } ]) {
+        
+        for (NSDictionary* options in @[ @{ @"byName" : @YES },
+                                         @{ @"byName" : @YES, @"multiple" : @(NSUIntegerMax) } ]) {
+            for (NSUInteger tree = 0; tree < models.count; ++tree) {
+                XCTAssert([[archive predictWithTree:tree arguments:arguments options:options]
+                           isEqualToArray:[ensemble.models[tree] predictWithArguments:arguments options:options]]);
+            }
+        }
+        for (NSNumber* method in @[ @(ML4iOSPredictionMethodPlurality),
+                                    @(ML4iOSPredictionMethodConfidence),
+                                    @(ML4iOSPredictionMethodProbability) ]) {
+            NSDictionary* options = @{ @"byName" : @YES, @"method" : method };
+            XCTAssert([[archive combinedPredictionWithArguments:arguments options:options]
+                       isEqualToDictionary:[ensemble predictWithArguments:arguments options:options]]);
+        }
+    }
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (NSDictionary*)combineVotes:(NSArray*)predictions
+                       method:(ML4iOSPredictionMethod)method
+                      options:(NSDictionary*)options {
+    
+    MultiVote* votes = [MultiVote new];
+    for (NSDictionary* prediction in predictions) {
+        [votes append:prediction];
+    }
+    return [votes combineWithMethod:method
+                         confidence:YES
+                       distribution:NO
+                              count:NO
+                             median:NO
+                                min:NO
+                                max:NO
+                            options:options];
+}
+
+- (void)testMultiVoteCombineCategorical {
+    
+    NSArray* predictions = @[ @{ @"prediction" : @"A", @"confidence" : @0.9, @"count" : @10,
+                                 @"distribution" : @{ @"A" : @9, @"B" : @1 } },
+                              @{ @"prediction" : @"B", @"confidence" : @0.6, @"count" : @5,
+                                 @"distribution" : @{ @"B" : @3, @"A" : @2 } },
+                              @{ @"prediction" : @"B", @"confidence" : @0.5, @"count" : @4,
+                                 @"distribution" : @{ @"B" : @4 } } ];
+    
+    NSDictionary* plurality = [self combineVotes:predictions method:ML4iOSPredictionMethodPlurality options:nil];
+    XCTAssert([plurality[@"prediction"] isEqualToString:@"B"]);
+    XCTAssertEqualWithAccuracy([plurality[@"confidence"] doubleValue], 2.0 / 3, 1e-9);
+    
+    NSDictionary* confidence = [self combineVotes:predictions method:ML4iOSPredictionMethodConfidence options:nil];
+    XCTAssert([confidence[@"prediction"] isEqualToString:@"B"]);
+    XCTAssertEqualWithAccuracy([confidence[@"confidence"] doubleValue], 0.71, 1e-9);
+    
+    NSDictionary* probability = [self combineVotes:predictions method:ML4iOSPredictionMethodProbability options:nil];
+    XCTAssert([probability[@"prediction"] isEqualToString:@"B"]);
+    XCTAssertEqualWithAccuracy([probability[@"confidence"] doubleValue], 0.3519247, 1e-6);
+    
+    NSDictionary* threshold = [self combineVotes:predictions
+                                          method:ML4iOSPredictionMethodThreshold
+                                         options:@{ @"threshold-k" : @1, @"threshold-category" : @"A" }];
+    XCTAssert([threshold[@"prediction"] isEqualToString:@"A"]);
+    XCTAssertEqualWithAccuracy([threshold[@"confidence"] doubleValue], 0.9, 1e-9);
+}
+
 - (void)testStoredIrisEnsemble {
     
     NSBundle* bundle = [NSBundle bundleForClass:[self class]];
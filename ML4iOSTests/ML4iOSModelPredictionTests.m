@@ -17,6 +17,13 @@
 #import "ML4iOSTester.h"
 #import "ML4iOSTestCase.h"
 #import "ML4iOSLocalPredictions.h"
+#import "PredictiveModel.h"
+#import "PredictionTree.h"
+#import "CompiledTree.h"
+#import "ModelArchive.h"
+#import "JSONReader.h"
+#import "TreePrediction.h"
+#import "ML4iOSUtils.h"
 
 @interface ML4iOSModelPredictionTests : ML4iOSTestCase
 
@@ -68,6 +75,278 @@
     XCTAssert([prediction[@"prediction"] isEqualToString:@"Iris-versicolor"], @"Pass");
 }
 
+- (void)testStoredIrisCompiledTree {
+    
+    NSDictionary* model = [self storedResourceNamed:@"iris" ofType:@"model"];
+    model = model[@"object"] ?: model;
+    NSDictionary* fields = model[@"model"][@"model_fields"];
+    PredictionTree* tree = [[PredictionTree alloc] initWithRoot:model[@"model"][@"root"]
+                                                         fields:fields
+                                                 objectiveField:@"000004"
+                                               rootDistribution:nil
+                                                       parentId:nil
+                                                         idsMap:[NSMutableDictionary new]
+                                                        subtree:YES
+                                                        maxBins:0];
+    CompiledTree* compiledTree = [[CompiledTree alloc] initWithTree:tree fields:fields];
+    
+    for (NSDictionary* arguments in @[ @{ @"000001": @3.15, @"000002": @4.07, @"000003": @1.51 },
+                                       @{ @"000001": @4.1, @"000002": @0.96, @"000003": @2.52 },
+                                       @{ @"000002": @5.5 },
+                                       @{} ]) {
+        
+        TreePrediction* prediction1 = [tree predict:arguments
+                                               path:nil
+                                           strategy:MissingStrategyLastPrediction];
+        TreePrediction* prediction2 = [compiledTree predict:arguments];
+        
+        XCTAssert([prediction1.prediction isEqual:prediction2.prediction]);
+        XCTAssert(prediction1.confidence == prediction2.confidence);
+        XCTAssert(prediction1.count == prediction2.count);
+        XCTAssert([prediction1.path isEqualToArray:prediction2.path]);
+        XCTAssert([prediction1.distribution isEqualToArray:prediction2.distribution]);
+    }
+}
+
+- (void)testStoredIrisModelArchive {
+    
+    PredictiveModel* model = [[PredictiveModel alloc] initWithJSONModel:[self storedResourceNamed:@"iris" ofType:@"model"]];
+    NSString* path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"iris.ml4b"];
+    NSError* error = nil;
+    XCTAssert([ModelArchive writeModels:@[ model ] toFile:path error:&error]);
+    
+    ModelArchive* archive = [[ModelArchive alloc] initWithContentsOfFile:path error:&error];
+    XCTAssert(archive && !error);
+    XCTAssert(archive.treeCount == 1);
+    
+    for (NSDictionary* arguments in @[ @{ @"sepal width": @3.15, @"petal length": @4.07, @"petal width": @1.51 },
+                                       @{ @"sepal width": @4.1, @"petal length": @0.96, @"petal width": @2.52 },
+                                       @{ @"petal length": @5.5 },
+                                       @{} ]) {
+        for (NSNumber* multiple in @[ @0, @(NSUIntegerMax) ]) {
+            NSDictionary* options = @{ @"byName" : @YES, @"multiple" : multiple };
+            XCTAssert([[archive predictWithArguments:arguments options:options]
+                       isEqualToArray:[model predictWithArguments:arguments options:options]]);
+        }
+    }
+    
+    //-- options the archive cannot honour are rejected, not ignored
+    NSDictionary* arguments = @{ @"petal length": @5.5 };
+    for (NSDictionary* options in @[ @{ @"byName" : @YES, @"strategy" : @(MissingStrategyProportional) },
+                                     @{ @"byName" : @YES, @"path" : @YES } ]) {
+        XCTAssertNil([archive predictWithArguments:arguments options:options]);
+        XCTAssertNil([archive combinedPredictionWithArguments:arguments options:options]);
+    }
+    
+    //-- the root's children looping back to it, then its distribution out of the table
+    NSData* valid = [NSData dataWithContentsOfFile:path];
+    const ModelArchiveHeader* header = valid.bytes;
+    NSDictionary* corruptions = @{ @(offsetof(ModelArchiveNode, firstChild)) : @0,
+                                   @(offsetof(ModelArchiveNode, firstEntry)) : @(header->entries.count) };
+    for (NSNumber* offset in corruptions) {
+        NSMutableData* corrupted = [valid mutableCopy];
+        uint32_t index = [corruptions[offset] unsignedIntValue];
+        [corrupted replaceBytesInRange:(NSRange){ header->nodes.offset + [offset unsignedIntegerValue], sizeof(index) }
+                             withBytes:&index];
+        [corrupted writeToFile:path atomically:YES];
+        error = nil;
+        XCTAssertNil([[ModelArchive alloc] initWithContentsOfFile:path error:&error]);
+        XCTAssert(error.code == ModelArchiveErrorInvalidFormat);
+    }
+    
+    [[NSData dataWithBytes:"ML4iOS" length:6] writeToFile:path atomically:YES];
+    XCTAssertNil([[ModelArchive alloc] initWithContentsOfFile:path error:&error]);
+    XCTAssert(error.code == ModelArchiveErrorInvalidFormat);
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testStoredIrisModelFromJSONData {
+    
+    NSData* data = [self storedDataNamed:@"iris" ofType:@"model"];
+    PredictiveModel* model1 = [[PredictiveModel alloc] initWithJSONModel:[self storedResourceNamed:@"iris" ofType:@"model"]];
+    PredictiveModel* model2 = [[PredictiveModel alloc] initWithJSONData:data];
+    XCTAssert(model2);
+    XCTAssert(model2.tree.children.count == model1.tree.children.count);
+    XCTAssert([model2.tree.objectiveFields isEqualToArray:model1.tree.objectiveFields]);
+    XCTAssert([model2.tree.children.firstObject predicate].field != nil);
+    
+    for (NSDictionary* arguments in @[ @{ @"sepal width": @3.15, @"petal length": @4.07, @"petal width": @1.51 },
+                                       @{ @"petal length": @5.5 } ]) {
+        for (NSNumber* strategy in @[ @(MissingStrategyLastPrediction), @(MissingStrategyProportional) ]) {
+            NSDictionary* options = @{ @"byName" : @YES, @"multiple" : @(NSUIntegerMax), @"strategy" : strategy };
+            XCTAssert([[model1 predictWithArguments:arguments options:options]
+                       isEqualToArray:[model2 predictWithArguments:arguments options:options]]);
+        }
+    }
+    XCTAssertNil([[PredictiveModel alloc] initWithJSONData:[@"{\"object\": " dataUsingEncoding:NSUTF8StringEncoding]]);
+}
+
+- (void)testStoredIrisModelsShareFields {
+    
+    NSDictionary* jsonModel = [self storedResourceNamed:@"iris" ofType:@"model"];
+    PredictiveModel* model1 = [[PredictiveModel alloc] initWithJSONModel:jsonModel];
+    PredictiveModel* model2 = [[PredictiveModel alloc] initWithJSONModel:[self storedResourceNamed:@"iris" ofType:@"model"]];
+    
+    XCTAssert(model1.schema == model2.schema);
+    XCTAssert(model1.fields == model2.fields);
+    XCTAssert([model1.fieldIdByName isEqualToDictionary:model2.fieldIdByName]);
+    
+    NSDictionary* arguments = @{ @"sepal width": @3.15, @"petal length": @4.07, @"petal width": @1.51 };
+    XCTAssert([[model1 predictWithArguments:arguments options:@{ @"byName" : @YES }]
+               isEqualToArray:[model2 predictWithArguments:arguments options:@{ @"byName" : @YES }]]);
+    
+    //-- the shared fields are a copy, which later changes to a loader's JSON do not reach
+    NSMutableDictionary* mutableModel = [self storedResourceNamed:@"iris" ofType:@"model"];
+    PredictiveModel* model3 = [[PredictiveModel alloc] initWithJSONModel:mutableModel];
+    XCTAssert(model3.fields == model1.fields);
+    NSString* fieldId = model1.schema.fieldIds.firstObject;
+    NSMutableDictionary* resourceModel = mutableModel[@"object"] ?: mutableModel;
+    [resourceModel[@"model"][@"fields"][fieldId][@"summary"] setObject:@YES forKey:@"changed"];
+    [resourceModel[@"model"][@"model_fields"][fieldId] setObject:@"changed" forKey:@"name"];
+    XCTAssertNil(model1.fields[fieldId][@"summary"][@"changed"]);
+    XCTAssertNotEqualObjects(model1.fields[fieldId][@"name"], @"changed");
+}
+
+- (void)testJSONReaderKeepsSelectedValues {
+    
+    NSString* json = @"{\"a\": [1, 2.5, -3e2, true, null], \"b\": \"\\u00e9\\ud83d\\ude00\\n\", "
+    "\"c\": {\"d\": 1, \"e\": {\"f\": [\"skipped\"]}}, \"g\": \"skipped\"}";
+    NSError* error = nil;
+    NSDictionary* object = [JSONReader objectWithData:[json dataUsingEncoding:NSUTF8StringEncoding]
+                                              keeping:@{ @"a" : @YES, @"b" : @YES, @"c" : @{ @"d" : @YES } }
+                                                error:&error];
+    NSDictionary* expected = @{ @"a" : @[ @1, @2.5, @(-300.0), @YES, [NSNull null] ],
+                                @"b" : @"\u00e9\U0001F600\n",
+                                @"c" : @{ @"d" : @1 } };
+    XCTAssert(!error && [object isEqualToDictionary:expected]);
+    
+    XCTAssertNil([JSONReader objectWithData:[@"[1, 2" dataUsingEncoding:NSUTF8StringEncoding]
+                                    keeping:@YES
+                                      error:&error]);
+    XCTAssert([error.domain isEqualToString:JSONReaderErrorDomain]);
+}
+
+- (void)testStoredIrisPrecomputedOutputs {
+    
+    PredictiveModel* model = [[PredictiveModel alloc] initWithJSONModel:[self storedResourceNamed:@"iris" ofType:@"model"]];
+    NSDictionary* arguments = @{ @"sepal width": @3.15, @"petal length": @4.07, @"petal width": @1.51 };
+    
+    for (NSNumber* strategy in @[ @(MissingStrategyLastPrediction), @(MissingStrategyProportional) ]) {
+        NSArray* predictions = [model predictWithArguments:arguments
+                                                   options:@{ @"byName" : @YES,
+                                                              @"multiple" : @(NSUIntegerMax),
+                                                              @"strategy" : strategy }];
+        XCTAssert(predictions.count > 0);
+        for (NSDictionary* prediction in predictions) {
+            double confidence = [ML4iOSUtils wsConfidence:prediction[@"prediction"]
+                                             distribution:prediction[@"distribution"]];
+            XCTAssertEqualWithAccuracy([prediction[@"confidence"] doubleValue], confidence, 0.0001);
+        }
+    }
+}
+
+- (void)addLeavesOfTree:(PredictionTree*)tree toDistribution:(NSMutableDictionary*)distribution {
+    
+    if (tree.children.count == 0) {
+        [ML4iOSUtils mergeDistribution:distribution
+                       andDistribution:tree.distributionDictionary];
+    }
+    for (PredictionTree* child in tree.children) {
+        [self addLeavesOfTree:child toDistribution:distribution];
+    }
+}
+
+- (void)testStoredIrisProportionalMissing {
+    
+    NSDictionary* model = [self storedResourceNamed:@"iris" ofType:@"model"];
+    model = model[@"object"] ?: model;
+    PredictionTree* tree = [[PredictionTree alloc] initWithRoot:model[@"model"][@"root"]
+                                                         fields:model[@"model"][@"model_fields"]
+                                                 objectiveField:@"000004"
+                                               rootDistribution:nil
+                                                       parentId:nil
+                                                         idsMap:[NSMutableDictionary new]
+                                                        subtree:YES
+                                                        maxBins:0];
+    NSMutableDictionary* leaves = [NSMutableDictionary new];
+    [self addLeavesOfTree:tree toDistribution:leaves];
+    
+    TreePrediction* prediction = [tree predict:@{}
+                                      strategy:MissingStrategyProportional
+                                      withPath:YES];
+    XCTAssert([[ML4iOSUtils dictionaryFromDistributionArray:prediction.distribution] isEqualToDictionary:leaves]);
+    XCTAssert(prediction.path.count == 0);
+    
+    prediction = [tree predict:@{ @"000002": @5.5 }
+                      strategy:MissingStrategyProportional
+                      withPath:YES];
+    XCTAssert(prediction.path.count > 0);
+    XCTAssert(prediction.count < [[leaves.allValues valueForKeyPath:@"@sum.self"] longValue]);
+}
+
+- (void)testMergeBins {
+    
+    NSArray* distribution = @[ @[@1.0, @2], @[@1.5, @2], @[@4.0, @1], @[@10.0, @3], @[@11.0, @1] ];
+    XCTAssert([[ML4iOSUtils mergeBins:distribution limit:8] isEqualToArray:distribution]);
+    
+    NSArray* merged = [ML4iOSUtils mergeBins:distribution limit:3];
+    NSArray* expected = @[ @[@1.25, @4], @[@4.0, @1], @[@10.25, @4] ];
+    XCTAssert(merged.count == expected.count);
+    for (NSUInteger i = 0; i < expected.count; ++i) {
+        XCTAssertEqualWithAccuracy([merged[i][0] doubleValue], [expected[i][0] doubleValue], 1e-9);
+        XCTAssertEqual([merged[i][1] longValue], [expected[i][1] longValue]);
+    }
+}
+
+- (void)testStoredIrisBatchPrediction {
+    
+    PredictiveModel* model = [[PredictiveModel alloc] initWithJSONModel:[self storedResourceNamed:@"iris" ofType:@"model"]];
+    NSArray* rows = @[ @{ @"sepal width": @3.15, @"petal length": @4.07, @"petal width": @1.51 },
+                       @{ @"sepal width": @4.1, @"petal length": @0.96, @"petal width": @2.52 },
+                       @{ @"petal length": @"N/A" } ];
+    NSArray* predictions = nil;
+    
+    for (NSDictionary* options in @[ @{ @"byName" : @YES },
+                                     @{ @"byName" : @YES, @"path" : @YES },
+                                     @{ @"byName" : @YES, @"strategy" : @(MissingStrategyProportional) } ]) {
+        
+        predictions = [model predictBatch:rows options:options];
+        NSArray* columnPredictions =
+        [model predictBatchWithColumns:@{ @"sepal width": @[@3.15, @4.1, [NSNull null]],
+                                          @"petal length": @[@4.07, @0.96, @"N/A"],
+                                          @"petal width": @[@1.51, @2.52] }
+                               options:options];
+        
+        XCTAssert(predictions.count == rows.count && columnPredictions.count == rows.count);
+        for (NSUInteger i = 0; i < rows.count; ++i) {
+            NSDictionary* expected = [model predictWithArguments:rows[i] options:options].firstObject;
+            XCTAssert([predictions[i] isEqualToArray:@[expected]]);
+            XCTAssert([columnPredictions[i] isEqualToArray:@[expected]]);
+        }
+    }
+    XCTAssert([[predictions[0] firstObject][@"prediction"] isEqualToString:@"Iris-versicolor"]);
+}
+
+- (void)testStoredIrisPredictionPath {
+    
+    PredictiveModel* model = [[PredictiveModel alloc] initWithJSONModel:[self storedResourceNamed:@"iris" ofType:@"model"]];
+    NSDictionary* arguments = @{ @"sepal width": @3.15, @"petal length": @4.07, @"petal width": @1.51 };
+    
+    NSDictionary* prediction = [model predictWithArguments:arguments
+                                                   options:@{ @"byName" : @YES }].firstObject;
+    XCTAssert(prediction[@"path"] == nil);
+    
+    for (NSNumber* strategy in @[ @(MissingStrategyLastPrediction), @(MissingStrategyProportional) ]) {
+        NSDictionary* predictionWithPath =
+        [model predictWithArguments:arguments
+                            options:@{ @"byName" : @YES, @"path" : @YES, @"strategy" : strategy }].firstObject;
+        NSArray* path = predictionWithPath[@"path"];
+        XCTAssert(path.count > 0);
+        XCTAssert([path.firstObject hasPrefix:@"petal length > 2.45"]);
+        XCTAssert([predictionWithPath[@"prediction"] isEqualToString:prediction[@"prediction"]]);
+    }
+}
+
 - (void)testLocalIrisPredictionAgainstRemote1 {
     
     self.apiLibrary.csvFileName = @"iris.csv";
@@ -14,5 +14,16 @@
 
 @property (nonatomic, readonly) ML4iOSTester* apiLibrary;
 
+/**
+ * The bytes of a resource stored in the test bundle, mapped if possible
+ */
+- (NSData*)storedDataNamed:(NSString*)name ofType:(NSString*)type;
+
+/**
+ * The JSON of a resource stored in the test bundle (e.g. a model, cluster
+ * or anomaly), read with mutable containers so that tests can edit it
+ */
+- (id)storedResourceNamed:(NSString*)name ofType:(NSString*)type;
+
 @end
 
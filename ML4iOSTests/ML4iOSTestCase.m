@@ -30,4 +30,22 @@
     self.apiLibrary.csvFileName = @"iris.csv";
 }
 
+- (NSData*)storedDataNamed:(NSString*)name ofType:(NSString*)type {
+    
+    NSBundle* bundle = [NSBundle bundleForClass:[self class]];
+    return [NSData dataWithContentsOfFile:[bundle pathForResource:name ofType:type]
+                                  options:NSDataReadingMappedIfSafe
+                                    error:nil];
+}
+
+- (id)storedResourceNamed:(NSString*)name ofType:(NSString*)type {
+    
+    NSError* error = nil;
+    id resource = [NSJSONSerialization JSONObjectWithData:[self storedDataNamed:name ofType:type]
+                                                  options:NSJSONReadingMutableContainers
+                                                    error:&error];
+    XCTAssert(resource, @"Could not read %@.%@: %@", name, type, error);
+    return resource;
+}
+
 @end
@@ -45,6 +45,79 @@
     XCTAssert(![RegExHelper isRegex:@"a$" matching:@"abcdefg"], @"Failed Regex: g$");
 }
 
+- (void)testPredicateApply {
+    
+    NSDictionary* input = @{ @"000001" : @3.15, @"000004" : @"Iris-setosa" };
+    
+    Predicate* gt = [[Predicate alloc] initWithOperator:@">" field:@"000001" value:@2.45 term:nil];
+    Predicate* le = [[Predicate alloc] initWithOperator:@"<=" field:@"000001" value:@2.45 term:nil];
+    Predicate* eq = [[Predicate alloc] initWithOperator:@"=" field:@"000004" value:@"Iris-setosa" term:nil];
+    Predicate* ne = [[Predicate alloc] initWithOperator:@"!=" field:@"000004" value:@"Iris-setosa" term:nil];
+    Predicate* ne2 = [[Predicate alloc] initWithOperator:@"/=" field:@"000004" value:@"Iris-virginica" term:nil];
+    Predicate* in = [[Predicate alloc] initWithOperator:@"in" field:@"000004"
+                                                  value:@[@"Iris-setosa", @"Iris-virginica"] term:nil];
+    Predicate* missing = [[Predicate alloc] initWithOperator:@"<*" field:@"000002" value:@1.5 term:nil];
+    Predicate* notMissing = [[Predicate alloc] initWithOperator:@"<" field:@"000002" value:@1.5 term:nil];
+    
+    XCTAssert([gt apply:input fields:nil]);
+    XCTAssert(![le apply:input fields:nil]);
+    XCTAssert([eq apply:input fields:nil]);
+    XCTAssert(![ne apply:input fields:nil]);
+    XCTAssert([ne2 apply:input fields:nil]);
+    XCTAssert([in apply:input fields:nil]);
+    XCTAssert(missing.missing && missing.operatorCode == PredicateOperatorLessThan);
+    XCTAssert([missing apply:input fields:nil]);
+    XCTAssert(![notMissing apply:input fields:nil]);
+}
+
+- (void)testPredicateApplyToValues {
+    
+    FieldSchema* schema = [[FieldSchema alloc] initWithFields:@{ @"000001" : @{}, @"000002" : @{}, @"000004" : @{} }];
+    XCTAssert(schema.count == 3 && [schema indexOfFieldId:@"000002"] == 1);
+    XCTAssert([schema indexOfFieldId:@"000003"] == NSNotFound);
+    
+    NSArray* predicates = @[ [[Predicate alloc] initWithOperator:@">" field:@"000001" value:@2.45 term:nil],
+                             [[Predicate alloc] initWithOperator:@"<=" field:@"000001" value:@2.45 term:nil],
+                             [[Predicate alloc] initWithOperator:@"=" field:@"000004" value:@"Iris-setosa" term:nil],
+                             [[Predicate alloc] initWithOperator:@"in" field:@"000004"
+                                                           value:@[@"Iris-setosa"] term:nil],
+                             [[Predicate alloc] initWithOperator:@"<*" field:@"000002" value:@1.5 term:nil],
+                             [[Predicate alloc] initWithOperator:@"<" field:@"000003" value:@1.5 term:nil] ];
+    
+    for (NSDictionary* input in @[ @{ @"000001" : @3.15, @"000004" : @"Iris-setosa" },
+                                   @{ @"000001" : @1, @"000002" : @1.2, @"000004" : @"Iris-virginica" },
+                                   @{} ]) {
+        FieldValue values[3];
+        [schema bindInput:input values:values];
+        for (Predicate* predicate in predicates) {
+            [predicate bindToSchema:schema];
+            XCTAssert([predicate apply:input fields:nil] == [predicate applyToValues:values fields:nil]);
+        }
+    }
+}
+
+- (void)testTermMatcher {
+    
+    TermMatcher* tokens = [[TermMatcher alloc] initWithTerm:@"free"
+                                                      forms:@[@"freely"]
+                                                    options:@{ @"case_sensitive" : @NO }];
+    XCTAssert(!tokens.isFullTerm);
+    XCTAssert([tokens countIn:@"FREE entry, free_call and freely given"] == 3);
+    XCTAssert([tokens countIn:@"freedom"] == 0);
+    
+    TermMatcher* fullTerms = [[TermMatcher alloc] initWithTerm:@"Hey there"
+                                                         forms:nil
+                                                       options:@{ @"token_mode" : @"full_terms_only" }];
+    XCTAssert(fullTerms.isFullTerm);
+    XCTAssert([fullTerms countIn:@"Hey there"] == 1);
+    XCTAssert([fullTerms countIn:@"hey there"] == 0);
+    
+    Predicate* contains = [[Predicate alloc] initWithOperator:@">" field:@"000001" value:@0 term:@"free"];
+    [contains prepareWithFields:@{ @"000001" : @{ @"name" : @"Message", @"optype" : @"text" } }];
+    XCTAssert([contains apply:@{ @"000001" : @"call now, it's free" } fields:nil]);
+    XCTAssert(![contains apply:@{ @"000001" : @"see you later" } fields:nil]);
+}
+
 - (void)testPerformanceExample {
     
     // This is an example of a performance test case.